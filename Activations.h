@@ -0,0 +1,172 @@
+#ifndef ACTIVATIONS_H
+#define ACTIVATIONS_H
+
+/** \file Activations.h The activation functions used by NeuralNet.
+
+    This file contains the activation functions (and the cost functions
+    they are paired with) that can be chosen for each layer of a
+    NeuralNet.  Each activation function is a policy class with static
+    methods that process a whole layer at once.  The network selects
+    the policy for a layer once (via withActivation) and the loops over
+    the values are then monomorphic and inlined, without any virtual
+    calls or std::function calls per value.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "Matrix.h"
+#include "MatrixKernels.h"
+
+/** The activation functions that can be used for each layer.  The
+    values are stored in checkpoint files and must not be changed. */
+enum class Activation : uint32_t {
+    Sigmoid = 0, ReLU = 1, Tanh = 2, Softmax = 3
+};
+
+/** The cost functions that can be minimized by the network.  The
+    values are stored in checkpoint files and must not be changed. */
+enum class Loss : uint32_t {
+    Quadratic = 0, CrossEntropy = 1
+};
+
+/**
+ * The sigmoid activation, 1 / (1 + exp(-z)), using the SIMD kernels.
+ *
+ * Each of the activation policies provides the following two methods:
+ *
+ * <ul>
+ * <li>activate(vals, rows, cols): Replaces the weighted inputs of a
+ * layer (a rows x cols matrix with one image per column) with the
+ * activations.</li>
+ *
+ * <li>mulDerivative(act, delta, n): Multiplies each of the n errors
+ * in delta by the derivative of the activation function, computed
+ * from the activations (so that the weighted inputs need not be
+ * stored).</li>
+ * </ul>
+ */
+struct SigmoidPolicy {
+    static void activate(Val* vals, const size_t rows, const size_t cols) {
+        matrixKernels().sigmoid(vals, vals, rows * cols);
+    }
+
+    static void mulDerivative(const Val* act, Val* delta, const size_t n) {
+        matrixKernels().sigmoidGrad(act, delta, n);
+    }
+};
+
+/** The rectified linear activation, max(0, z) */
+struct ReLUPolicy {
+    static void activate(Val* vals, const size_t rows, const size_t cols) {
+        for (size_t i = 0; (i < rows * cols); i++) {
+            vals[i] = std::max(vals[i], Val(0));
+        }
+    }
+
+    static void mulDerivative(const Val* act, Val* delta, const size_t n) {
+        for (size_t i = 0; (i < n); i++) {
+            delta[i] = (act[i] > 0) ? delta[i] : Val(0);
+        }
+    }
+};
+
+/** The hyperbolic tangent activation, with derivative 1 - a^2 */
+struct TanhPolicy {
+    static void activate(Val* vals, const size_t rows, const size_t cols) {
+        // Use tanh(z) = 2 * sigmoid(2z) - 1 to reuse the SIMD kernels.
+        const MatrixKernels& kernels = matrixKernels();
+        const size_t n = rows * cols;
+        kernels.scale(vals, 2, vals, n);
+        kernels.sigmoid(vals, vals, n);
+        for (size_t i = 0; (i < n); i++) {
+            vals[i] = 2 * vals[i] - 1;
+        }
+    }
+
+    static void mulDerivative(const Val* act, Val* delta, const size_t n) {
+        for (size_t i = 0; (i < n); i++) {
+            delta[i] *= 1 - act[i] * act[i];
+        }
+    }
+};
+
+/**
+ * The softmax activation, which normalizes the outputs for each image
+ * (i.e., each column) so that they sum to 1.0.  This activation is
+ * only supported on the output layer together with cross-entropy,
+ * where the error of the outputs is simply (a - y).
+ */
+struct SoftmaxPolicy {
+    static void activate(Val* vals, const size_t rows, const size_t cols) {
+        for (size_t col = 0; (col < cols); col++) {
+            // Subtract the maximum so that exp cannot overflow.
+            Val maxVal = vals[col];
+            for (size_t row = 1; (row < rows); row++) {
+                maxVal = std::max(maxVal, vals[row * cols + col]);
+            }
+            Val sum = 0;
+            for (size_t row = 0; (row < rows); row++) {
+                Val& val = vals[row * cols + col];
+                val = std::exp(val - maxVal);
+                sum += val;
+            }
+            for (size_t row = 0; (row < rows); row++) {
+                vals[row * cols + col] /= sum;
+            }
+        }
+    }
+
+    static void mulDerivative(const Val*, Val*, const size_t) {
+        throw std::logic_error("Softmax can only be used on the output "
+                               "layer with cross-entropy");
+    }
+};
+
+/**
+ * Calls a given callable with the policy object for an activation
+ * function.  The callable is typically a generic lambda so that it is
+ * instantiated (and inlined) once for each policy.  For example:
+ *
+ * \code
+ * withActivation(act, [&](auto policy) {
+ *     decltype(policy)::activate(vals, rows, cols);
+ * });
+ * \endcode
+ *
+ * \param[in] act The activation function to be used.
+ *
+ * \param[in] fn The callable to be called with the policy object.
+ */
+template<typename Fn>
+void withActivation(const Activation act, const Fn& fn) {
+    switch (act) {
+    case Activation::ReLU:    fn(ReLUPolicy());    break;
+    case Activation::Tanh:    fn(TanhPolicy());    break;
+    case Activation::Softmax: fn(SoftmaxPolicy()); break;
+    default:                  fn(SigmoidPolicy()); break;
+    }
+}
+
+/**
+ * Returns the activation function with a given name, which is one of
+ * "sigmoid", "relu", "tanh", or "softmax".
+ *
+ * \param[in] name The name of the activation function.  An exception
+ * is thrown if the name is not valid.
+ *
+ * \return The corresponding activation function.
+ */
+inline Activation parseActivation(const std::string& name) {
+    if (name == "sigmoid") return Activation::Sigmoid;
+    if (name == "relu")    return Activation::ReLU;
+    if (name == "tanh")    return Activation::Tanh;
+    if (name == "softmax") return Activation::Softmax;
+    throw std::invalid_argument("Unknown activation function: " + name);
+}
+
+#endif
@@ -0,0 +1,93 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef BATCH_LOADER_CPP
+#define BATCH_LOADER_CPP
+
+#include <algorithm>
+#include "BatchLoader.h"
+
+// Used in readyBatch to indicate that a slot does not have a batch.
+static constexpr size_t NoBatch = static_cast<size_t>(-1);
+
+BatchLoader::BatchLoader(const size_t count, const size_t imgSize,
+                         const size_t batchSize, const FillFn& fill,
+                         const size_t threads, const size_t depth) :
+    count(count), imgSize(imgSize), batchSize(std::max<size_t>(batchSize, 1)),
+    batchCount((count + this->batchSize - 1) / this->batchSize), fill(fill),
+    slots(std::max<size_t>(depth, 1)), readyBatch(slots.size(), NoBatch) {
+    for (size_t i = 0; (i < std::max<size_t>(threads, 1)); i++) {
+        loaders.emplace_back(&BatchLoader::loadBatches, this);
+    }
+}
+
+BatchLoader::~BatchLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    slotFree.notify_all();
+    for (auto& thr : loaders) {
+        thr.join();
+    }
+}
+
+const BatchLoader::Batch* BatchLoader::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Recycle the slot of the batch returned by the previous call.
+    if (released < nextToUse) {
+        readyBatch[released % slots.size()] = NoBatch;
+        released = nextToUse;
+        slotFree.notify_all();
+    }
+    if (nextToUse >= batchCount) {
+        return nullptr;  // All batches have been used.
+    }
+    // Wait for the next batch (in order) to be loaded.
+    const size_t slot = nextToUse % slots.size();
+    batchReady.wait(lock, [&] {
+        return error || readyBatch[slot] == nextToUse; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    nextToUse++;
+    return &slots[slot];
+}
+
+void BatchLoader::loadBatches() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Wait until the slot for the next batch has been recycled.
+        // Batch b can use its slot once batch b - depth is released.
+        slotFree.wait(lock, [&] {
+            return stop || error || nextToLoad >= batchCount ||
+                nextToLoad < released + slots.size(); });
+        if (stop || error || nextToLoad >= batchCount) {
+            return;
+        }
+        const size_t batch = nextToLoad++;
+        Batch& buf = slots[batch % slots.size()];
+        lock.unlock();
+        // Assemble the batch without holding the lock.
+        try {
+            const size_t start = batch * batchSize;
+            const size_t size  = std::min(batchSize, count - start);
+            // Resize reuses the storage from the previous batch
+            buf.inputs.resize(imgSize, size);
+            buf.expected.resize(10, size);
+            for (size_t i = 0; (i < size); i++) {
+                fill(start + i, buf.inputs, buf.expected, i);
+            }
+            lock.lock();
+            readyBatch[batch % slots.size()] = batch;
+        } catch (...) {
+            lock.lock();
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        batchReady.notify_all();
+        slotFree.notify_all();  // So other loaders notice any error
+    }
+}
+
+#endif
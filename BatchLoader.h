@@ -0,0 +1,155 @@
+#ifndef BATCH_LOADER_H
+#define BATCH_LOADER_H
+
+/** \file BatchLoader.h An asynchronous, prefetching mini-batch loader.
+
+    This file contains a pipeline stage that assembles upcoming
+    mini-batches in background threads while the network is trained
+    on the current mini-batch. This hides the cost of loading and
+    decoding images (which is dominant in the first epoch) behind the
+    computation.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Matrix.h"
+
+/**
+ * A loader that assembles mini-batches (with one image per column) in
+ * background threads into a bounded ring of reusable buffers.  The
+ * batches are handed out in order via the next method.  For example:
+ *
+ * \code
+ * BatchLoader loader(count, 784, 10, fill);
+ * while (const auto* batch = loader.next()) {
+ *     net.learnBatch(batch->inputs, batch->expected);
+ * }
+ * \endcode
+ */
+class BatchLoader {
+public:
+    /**
+     * The callable used to load the images.  The call fill(i, imgs,
+     * exps, col) must copy the i-th image and its expected output into
+     * column col of imgs and exps.  If the loader uses more than one
+     * thread, this callable is called concurrently.
+     */
+    using FillFn = std::function<void(const size_t sample, Matrix& imgs,
+                                      Matrix& exps, const size_t col)>;
+
+    /** A mini-batch assembled by the loader */
+    struct Batch {
+        /** The images in this batch, one image per column */
+        Matrix inputs;
+
+        /** The expected output, one column per image */
+        Matrix expected;
+    };
+
+    /**
+     * Creates the loader and starts assembling batches right away.
+     *
+     * \param[in] count The total number of images to be loaded.
+     *
+     * \param[in] imgSize The number of pixels in each image.
+     *
+     * \param[in] batchSize The number of images in each batch. The
+     * last batch is smaller if count is not a multiple of batchSize.
+     *
+     * \param[in] fill The callable used to load each image.
+     *
+     * \param[in] threads The number of background threads to be used.
+     *
+     * \param[in] depth The maximum number of batches that are loaded
+     * ahead of the one being used.  This bounds the memory used.
+     */
+    BatchLoader(const size_t count, const size_t imgSize,
+                const size_t batchSize, const FillFn& fill,
+                const size_t threads = 1, const size_t depth = 4);
+
+    /**
+     * The destructor stops the background threads, even if not all
+     * of the batches have been used.
+     */
+    ~BatchLoader();
+
+    /** The loader is not copyable as it owns threads */
+    BatchLoader(const BatchLoader&) = delete;
+
+    /** The loader is not assignable as it owns threads */
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    /**
+     * Returns the next batch, waiting for it to be loaded if needed.
+     * The batch returned by the previous call is recycled by this
+     * call and must no longer be used.  If loading an image threw an
+     * exception, then that exception is rethrown by this method.
+     *
+     * \return The next batch or nullptr when all the batches have
+     * been used.
+     */
+    const Batch* next();
+
+private:
+    /**
+     * The method run by each background thread that loads batches
+     * until all batches have been loaded or the loader is destroyed.
+     */
+    void loadBatches();
+
+    /** The total number of images to be loaded */
+    const size_t count;
+
+    /** The number of pixels in each image */
+    const size_t imgSize;
+
+    /** The number of images in each batch */
+    const size_t batchSize;
+
+    /** The total number of batches to be loaded */
+    const size_t batchCount;
+
+    /** The callable used to load each image */
+    const FillFn fill;
+
+    /** The ring of buffers, with batch b stored in slot b % depth */
+    std::vector<Batch> slots;
+
+    /** The index of the batch that is ready in each slot */
+    std::vector<size_t> readyBatch;
+
+    /** The background threads loading the batches */
+    std::vector<std::thread> loaders;
+
+    /** Mutex to coordinate access to the variables below */
+    std::mutex mutex;
+
+    /** Used to notify the loaders that a slot has been recycled */
+    std::condition_variable slotFree;
+
+    /** Used to notify next that a batch is ready */
+    std::condition_variable batchReady;
+
+    /** The index of the next batch to be claimed by a loader */
+    size_t nextToLoad = 0;
+
+    /** The index of the next batch to be returned by next */
+    size_t nextToUse = 0;
+
+    /** The number of batches that have been used and recycled */
+    size_t released = 0;
+
+    /** The first exception thrown while loading a batch */
+    std::exception_ptr error;
+
+    /** Flag to indicate that the loaders should stop */
+    bool stop = false;
+};
+
+#endif
@@ -0,0 +1,357 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef BENCHMARK_CPP
+#define BENCHMARK_CPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include "Benchmark.h"
+#include "DataRepository.h"
+#include "FixedNeuralNet.h"
+#include "Matrix.h"
+#include "MatrixKernels.h"
+#include "NeuralNet.h"
+#include "PoolAllocator.h"
+#include "QuantizedNet.h"
+#include "SparseVector.h"
+
+namespace {
+
+/** Results are written here so that the compiler cannot remove the
+    operations being measured */
+volatile Val sink;
+
+// Returns a matrix filled with random values in [0, 1).
+Matrix randomMatrix(const size_t rows, const size_t cols,
+                    std::mt19937& rng) {
+    std::uniform_real_distribution<Val> dist(0, 1);
+    Matrix mat(rows, cols);
+    for (Val& val : mat.data) {
+        val = dist(rng);
+    }
+    return mat;
+}
+
+// Returns a batch of one-hot expected outputs, one column per image.
+Matrix randomLabels(const size_t rows, const size_t cols,
+                    std::mt19937& rng) {
+    Matrix mat(rows, cols);
+    for (size_t col = 0; (col < cols); col++) {
+        mat.data[(rng() % rows) * cols + col] = 1;
+    }
+    return mat;
+}
+
+// Returns the floating-point operations for an m x k . k x n product.
+double gemmFlops(const size_t m, const size_t k, const size_t n) {
+    return 2.0 * m * k * n;
+}
+
+// Returns the floating-point operations in the matrix products of
+// the forward pass for one image.
+double forwardFlops(const std::vector<int>& layers) {
+    double flops = 0;
+    for (size_t l = 1; (l < layers.size()); l++) {
+        flops += gemmFlops(layers[l], layers[l - 1], 1);
+    }
+    return flops;
+}
+
+// Returns the floating-point operations in the matrix products of
+// the forward and backward passes for one image.  The backward pass
+// computes the weight gradients of every layer and the errors of all
+// but the first layer.
+double learnFlops(const std::vector<int>& layers) {
+    double flops = 2 * forwardFlops(layers);
+    for (size_t l = 2; (l < layers.size()); l++) {
+        flops += gemmFlops(layers[l - 1], layers[l], 1);
+    }
+    return flops;
+}
+
+// Returns the shape of a product as a string, for example 30x784*784x1.
+std::string shape(const size_t m, const size_t k, const size_t n) {
+    return std::to_string(m) + "x" + std::to_string(k) + "*" +
+        std::to_string(k) + "x" + std::to_string(n);
+}
+
+/** The state shared by the benchmarks in the suite */
+struct Suite {
+    std::ostream& os;
+    const std::string& filter;
+    size_t count = 0;
+
+    // Measures and reports a benchmark if it matches the filter.
+    void run(const std::string& name, const double flops,
+             const double samples, const std::function<void()>& op) {
+        if (name.find(filter) != std::string::npos) {
+            writeJson(os, measure(name, flops, samples, op));
+            count++;
+        }
+    }
+};
+
+// Writes a string as a JSON string.  The names used by the suite
+// only need quotes and backslashes to be escaped.
+void writeJsonString(std::ostream& os, const std::string& str) {
+    os << '"';
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+
+// Benchmarks the Matrix operations at the shapes used by training and
+// inference of a 784-30-10 network with mini-batches of 32 images.
+void matrixBenchmarks(Suite& suite, std::mt19937& rng) {
+    const size_t batch = 32;
+    const Matrix w1 = randomMatrix(30, 784, rng);
+    const Matrix w2 = randomMatrix(10, 30, rng);
+    const Matrix b1 = randomMatrix(30, 1, rng);
+    const Matrix x1 = randomMatrix(784, 1, rng);
+    const Matrix h1 = randomMatrix(30, 1, rng);
+    const Matrix xb = randomMatrix(784, batch, rng);
+    const Matrix hb = randomMatrix(30, batch, rng);
+    const Matrix db = randomMatrix(10, batch, rng);
+    Matrix result;
+
+    // The products of the forward pass for one image and for a batch.
+    suite.run("dot/" + shape(30, 784, 1), gemmFlops(30, 784, 1), 1,
+              [&] { w1.dot(x1, result); sink = result.data[0]; });
+    suite.run("dot/" + shape(10, 30, 1), gemmFlops(10, 30, 1), 1,
+              [&] { w2.dot(h1, result); sink = result.data[0]; });
+    suite.run("dot/" + shape(30, 784, batch), gemmFlops(30, 784, batch),
+              batch, [&] { w1.dot(xb, result); sink = result.data[0]; });
+    suite.run("dotAddBias/" + shape(30, 784, batch),
+              gemmFlops(30, 784, batch), batch,
+              [&] { w1.dotAddBias(xb, b1, result); sink = result.data[0]; });
+    suite.run("dotAlloc/" + shape(30, 784, batch), gemmFlops(30, 784, batch),
+              batch, [&] { sink = w1.dot(xb).data[0]; });
+    // The products of the backward pass for a batch.
+    suite.run("dotNT/30x32*(784x32)^T", gemmFlops(30, batch, 784), batch,
+              [&] { hb.dotNT(xb, result); sink = result.data[0]; });
+    suite.run("dotTN/(10x30)^T*10x32", gemmFlops(30, 10, batch), batch,
+              [&] { w2.dotTN(db, result); sink = result.data[0]; });
+    suite.run("transposeDot/(10x30)^T*10x32", gemmFlops(30, 10, batch),
+              batch, [&] { w2.transpose().dot(db, result);
+                           sink = result.data[0]; });
+    // The element-wise operations.
+    const auto sigmoid = [](const Val val) {
+        return 1 / (1 + std::exp(-val));
+    };
+    suite.run("apply/30x32", 0, batch,
+              [&] { result = hb.apply(sigmoid); sink = result.data[0]; });
+    Matrix hbCopy = hb;
+    suite.run("applyInPlace/30x32", 0, batch, [&] {
+        hbCopy.applyInPlace([](const Val val) { return val * Val(0.5); });
+        sink = hbCopy.data[0];
+    });
+    suite.run("sub/30x32", 30 * batch, batch,
+              [&] { result = hb - hb; sink = result.data[0]; });
+    // An error term as one fused expression and as separate steps.
+    const auto sigmoidPrime = [](const Val val) { return val * (1 - val); };
+    suite.run("fusedExpr/30x32", 0, batch, [&] {
+        result = (hb - hbCopy) * hb.apply(sigmoidPrime);
+        sink = result.data[0];
+    });
+    suite.run("unfusedExpr/30x32", 0, batch, [&] {
+        const Matrix diff = hb - hbCopy;
+        const Matrix prime = hb.apply(sigmoidPrime);
+        result = diff * prime;
+        sink = result.data[0];
+    });
+    suite.run("transpose/784x32", 0, batch,
+              [&] { xb.transpose(result); sink = result.data[0]; });
+}
+
+// Benchmarks training and inference of a network.
+void netBenchmarks(Suite& suite, std::mt19937& rng) {
+    const std::vector<int> layers = {784, 30, 10};
+    const size_t batch = 32;
+    NeuralNet net(layers);
+    const Matrix x1 = randomMatrix(784, 1, rng);
+    const Matrix y1 = randomLabels(10, 1, rng);
+    const Matrix xb = randomMatrix(784, batch, rng);
+    const Matrix yb = randomLabels(10, batch, rng);
+    const std::vector<float> pixels(x1.data.begin(), x1.data.end());
+    // A tiny learning rate keeps the weights (and hence the speed of
+    // the exp calls) roughly the same across iterations.
+    const Val eta = 1e-6;
+
+    suite.run("learn/784-30-10", learnFlops(layers), 1,
+              [&] { net.learn(x1, y1, eta); });
+    suite.run("learnBatch/784-30-10/32", learnFlops(layers) * batch, batch,
+              [&] { net.learnBatch(xb, yb, eta); });
+    suite.run("classify/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = net.classify(x1).data[0]; });
+    suite.run("classifyBatch/784-30-10/32", forwardFlops(layers) * batch,
+              batch, [&] { sink = net.classifyBatch(xb)[0]; });
+    suite.run("predict/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = net.predict(pixels.data()); });
+    // The same network with a compile-time topology.
+    auto fixedNet = std::make_unique<FixedNeuralNet<784, 30, 10>>(net);
+    suite.run("learnFixed/784-30-10", learnFlops(layers), 1,
+              [&] { fixedNet->learn(x1, y1, eta); });
+    suite.run("predictFixed/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = fixedNet->predict(pixels.data()); });
+    // About 20% of the pixels of a digit are non-zero, which is what
+    // the first layer of FixedNeuralNet relies on.
+    Matrix digit = x1;
+    std::bernoulli_distribution background(0.8);
+    for (Val& val : digit.data) {
+        val = background(rng) ? 0 : val;
+    }
+    const std::vector<float> digitPixels(digit.data.begin(),
+                                         digit.data.end());
+    SparseVector sparse;
+    sparse.assign(digit.data.data(), digit.rows);
+    suite.run("learnSparse/784-30-10", learnFlops(layers), 1,
+              [&] { fixedNet->learn(sparse, y1.data.data(), eta); });
+    suite.run("predictSparse/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = fixedNet->predict(sparse); });
+    suite.run("predictDigit/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = net.predict(digitPixels.data()); });
+    suite.run("predictFixedDigit/784-30-10", forwardFlops(layers), 1,
+              [&] { sink = fixedNet->predict(digitPixels.data()); });
+    // A batch of such digits with the dense and sparse first layer.
+    Matrix digits = xb;
+    for (Val& val : digits.data) {
+        val = background(rng) ? 0 : val;
+    }
+    NeuralNet sparseNet = net;
+    sparseNet.setSparseInputs(true);
+    suite.run("learnDigit/784-30-10", learnFlops(layers), 1,
+              [&] { net.learn(digit, y1, eta); });
+    suite.run("learnDigitSparse/784-30-10", learnFlops(layers), 1,
+              [&] { sparseNet.learn(digit, y1, eta); });
+    suite.run("learnBatchDigits/784-30-10/32", learnFlops(layers) * batch,
+              batch, [&] { net.learnBatch(digits, yb, eta); });
+    suite.run("learnBatchDigitsSparse/784-30-10/32",
+              learnFlops(layers) * batch, batch,
+              [&] { sparseNet.learnBatch(digits, yb, eta); });
+    if (QuantizedNet::isSupported(net)) {
+        const QuantizedNet qnet(net);
+        suite.run("predictInt8/784-30-10", forwardFlops(layers), 1,
+                  [&] { sink = qnet.predict(pixels.data()); });
+    }
+}
+
+// Benchmarks loading PGM files and the DataRepository cache.
+void loadBenchmarks(Suite& suite, const std::string& imgPath,
+                    const std::string& imgList) {
+    const DatasetIndex index(imgPath, imgList);
+    if (index.size() == 0) {
+        return;
+    }
+    // Cycle through up to 256 images so that each call loads a
+    // different file (as done in the first epoch).
+    const size_t count = std::min<size_t>(index.size(), 256);
+    size_t next = 0;
+    suite.run("loadPGM", 0, 1, [&] {
+        sink = loadPGM(index.path(next++ % count)).data[0];
+    });
+    suite.run("DataRepository/miss", 0, 1, [&] {
+        if (next % count == 0) {
+            DataRepository::reset();
+        }
+        const std::string& path = index.path(next++ % count);
+        sink = DataRepository::fetchImage(path).data[0];
+    });
+    // Load all the images so that every later fetch is a hit.
+    for (size_t i = 0; (i < count); i++) {
+        DataRepository::fetchImage(index.path(i));
+    }
+    suite.run("DataRepository/hit", 0, 1, [&] {
+        const std::string& path = index.path(next++ % count);
+        sink = DataRepository::fetchImage(path).data[0];
+    });
+    DataRepository::reset();
+}
+
+}  // namespace
+
+BenchResult measure(const std::string& name, const double flops,
+                    const double samples, const std::function<void()>& op,
+                    const double minSeconds, const int repetitions) {
+    using Clock = std::chrono::steady_clock;
+    // Warm up and then double the iterations until a repetition is
+    // long enough to be timed reliably.
+    op();
+    size_t iterations = 1;
+    while (true) {
+        const auto start = Clock::now();
+        for (size_t i = 0; (i < iterations); i++) {
+            op();
+        }
+        const std::chrono::duration<double> secs = Clock::now() - start;
+        if (secs.count() >= minSeconds) {
+            break;
+        }
+        iterations *= 2;
+    }
+    // Time the repetitions, counting the allocations made by them.
+    std::vector<double> nsPerIter;
+    const MemoryPool::Stats before = MemoryPool::stats();
+    for (int rep = 0; (rep < repetitions); rep++) {
+        const auto start = Clock::now();
+        for (size_t i = 0; (i < iterations); i++) {
+            op();
+        }
+        const std::chrono::duration<double, std::nano> ns =
+            Clock::now() - start;
+        nsPerIter.push_back(ns.count() / iterations);
+    }
+    const MemoryPool::Stats after = MemoryPool::stats();
+    std::sort(nsPerIter.begin(), nsPerIter.end());
+    const double median = nsPerIter[nsPerIter.size() / 2];
+    const double calls = double(iterations) * repetitions;
+    return {name, iterations, median, nsPerIter.front(),
+            (samples > 0) ? median / samples : 0,
+            (flops > 0) ? flops / median : 0,
+            (after.allocations - before.allocations) / calls,
+            (after.heapAllocations - before.heapAllocations) / calls};
+}
+
+void writeJson(std::ostream& os, const BenchResult& result) {
+    // Restore the formatting of the caller's stream at the end.
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << "{\"name\": ";
+    writeJsonString(os, result.name);
+    os << ", \"iterations\": " << result.iterations
+       << std::fixed << std::setprecision(1)
+       << ", \"ns_per_iter\": " << result.nsPerIter
+       << ", \"min_ns_per_iter\": " << result.minNsPerIter
+       << ", \"ns_per_sample\": " << result.nsPerSample
+       << std::setprecision(3)
+       << ", \"gflops\": " << result.gflops
+       << ", \"allocs_per_iter\": " << result.allocsPerIter
+       << ", \"heap_allocs_per_iter\": " << result.heapAllocsPerIter
+       << "}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+size_t runBenchmarks(std::ostream& os, const std::string& imgPath,
+                     const std::string& imgList, const std::string& filter) {
+    os << "{\"config\": {\"kernels\": ";
+    writeJsonString(os, matrixKernels().name);
+    os << ", \"val_bytes\": " << sizeof(Val) << "}}" << std::endl;
+    Suite suite{os, filter};
+    std::mt19937 rng;
+    matrixBenchmarks(suite, rng);
+    netBenchmarks(suite, rng);
+    if (!imgList.empty()) {
+        loadBenchmarks(suite, imgPath, imgList);
+    }
+    return suite.count;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/** \file Benchmark.h Micro-benchmarks for the hot paths of NeuralNet.
+
+    This file contains a small benchmark harness and the suite of
+    benchmarks for the Matrix operations (at the shapes used by the
+    784-30-10 network), training, inference, and image loading.  The
+    suite is run via the --bench mode of the main program and reports
+    each result as one JSON object per line so that the output can be
+    compared across changes and machines by scripts.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * The measurements for one benchmark.  Rates that do not apply to a
+ * benchmark (for example, GFLOP/s for loading images) are reported
+ * as zero.
+ */
+struct BenchResult {
+    /** The name of the benchmark, for example "dot/30x784*784x1" */
+    std::string name;
+    /** The number of times the operation was run per repetition */
+    size_t iterations;
+    /** The median time (in nanoseconds) for one operation */
+    double nsPerIter;
+    /** The fastest time (in nanoseconds) for one operation */
+    double minNsPerIter;
+    /** The median time divided by the number of images processed */
+    double nsPerSample;
+    /** The floating-point operations per second (in billions) */
+    double gflops;
+    /** The Matrix allocations per operation (see MemoryPool::stats) */
+    double allocsPerIter;
+    /** The allocations per operation that were not served by the pool */
+    double heapAllocsPerIter;
+};
+
+/**
+ * Runs an operation repeatedly and measures it.  The operation is
+ * run once to warm up caches and the memory pool, the number of
+ * iterations is then chosen so that each repetition takes at least
+ * minSeconds, and the median of several repetitions is reported (as
+ * it is less sensitive to noise than the mean).
+ *
+ * \param[in] name The name of the benchmark.
+ *
+ * \param[in] flops The number of floating-point operations performed
+ * by one call to op.  Zero if not applicable.
+ *
+ * \param[in] samples The number of images processed by one call to
+ * op.  Zero if not applicable.
+ *
+ * \param[in] op The operation to be measured.
+ *
+ * \param[in] minSeconds The minimum duration of each repetition.
+ *
+ * \param[in] repetitions The number of repetitions.
+ *
+ * \return The measurements.
+ */
+BenchResult measure(const std::string& name, const double flops,
+                    const double samples, const std::function<void()>& op,
+                    const double minSeconds = 0.1,
+                    const int repetitions = 5);
+
+/**
+ * Writes a result as a single-line JSON object.
+ *
+ * \param[out] os The output stream to which the result is written.
+ *
+ * \param[in] result The result to be written.
+ */
+void writeJson(std::ostream& os, const BenchResult& result);
+
+/**
+ * Runs the benchmark suite and writes one JSON line per benchmark to
+ * the given stream.  The first line describes the configuration (the
+ * SIMD kernels and the type of Val).  The benchmarks for loadPGM and
+ * DataRepository need images and are skipped if imgList is empty.
+ *
+ * \param[out] os The output stream to which the results are written.
+ *
+ * \param[in] imgPath The path where the images in imgList are
+ * stored.
+ *
+ * \param[in] imgList The file with the list of PGM images to be
+ * loaded.  Can be empty.
+ *
+ * \param[in] filter Only benchmarks whose names contain this string
+ * are run.  An empty filter runs all the benchmarks.
+ *
+ * \return The number of benchmarks run.
+ */
+size_t runBenchmarks(std::ostream& os, const std::string& imgPath = "",
+                     const std::string& imgList = "",
+                     const std::string& filter = "");
+
+#endif
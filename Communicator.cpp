@@ -0,0 +1,97 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef COMMUNICATOR_CPP
+#define COMMUNICATOR_CPP
+
+#include <stdexcept>
+#include "Communicator.h"
+
+#ifdef NNET_USE_MPI
+
+namespace {
+
+// Returns the MPI type corresponding to Val.
+MPI_Datatype valType() {
+    return (sizeof(Val) == sizeof(double)) ? MPI_DOUBLE : MPI_FLOAT;
+}
+
+}  // namespace
+
+Communicator::Communicator(int& argc, char**& argv) {
+    // Only the main thread makes MPI calls, but the thread pool and the
+    // batch loaders run other threads.
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        throw std::runtime_error("MPI does not support threads");
+    }
+    int id = 0, count = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &count);
+    rankID = id;
+    ranks  = count;
+}
+
+Communicator::~Communicator() {
+    waitAll();
+    MPI_Finalize();
+}
+
+void Communicator::startAllreduce(Val* data, const size_t count) {
+    if (ranks > 1) {
+        pending.emplace_back();
+        MPI_Iallreduce(MPI_IN_PLACE, data, count, valType(), MPI_SUM,
+                       MPI_COMM_WORLD, &pending.back());
+    }
+}
+
+void Communicator::progress() {
+    if (!pending.empty()) {
+        int done = 0;
+        MPI_Testall(pending.size(), pending.data(), &done,
+                    MPI_STATUSES_IGNORE);
+    }
+}
+
+void Communicator::waitAll() {
+    if (!pending.empty()) {
+        MPI_Waitall(pending.size(), pending.data(), MPI_STATUSES_IGNORE);
+        pending.clear();
+    }
+}
+
+void Communicator::allreduce(Val* data, const size_t count) {
+    if (ranks > 1) {
+        MPI_Allreduce(MPI_IN_PLACE, data, count, valType(), MPI_SUM,
+                      MPI_COMM_WORLD);
+    }
+}
+
+void Communicator::broadcast(Val* data, const size_t count) {
+    if (ranks > 1) {
+        MPI_Bcast(data, count, valType(), 0, MPI_COMM_WORLD);
+    }
+}
+
+#else
+
+// Without MPI there is only one rank, and the sum (or copy) of the
+// values on all the ranks is just the values on this rank.
+
+Communicator::Communicator(int&, char**&) {}
+
+Communicator::~Communicator() {}
+
+void Communicator::startAllreduce(Val*, const size_t) {}
+
+void Communicator::progress() {}
+
+void Communicator::waitAll() {}
+
+void Communicator::allreduce(Val*, const size_t) {}
+
+void Communicator::broadcast(Val*, const size_t) {}
+
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef COMMUNICATOR_H
+#define COMMUNICATOR_H
+
+/** \file Communicator.h Communication between the processes (ranks)
+    used for distributed training.
+
+    This file contains a thin wrapper around the few MPI operations
+    used to train a NeuralNet across several processes (typically on
+    different nodes).  MPI is used only if the program is compiled
+    with -DNNET_USE_MPI (and built via mpicxx).  Otherwise, the
+    program runs as a single rank and all of the operations are
+    no-ops.  So the rest of the code does not need any #ifdefs.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <vector>
+#include "Matrix.h"
+
+#ifdef NNET_USE_MPI
+#include <mpi.h>
+#endif
+
+/**
+ * The set of processes (ranks) that train a network together.  Each
+ * rank computes the gradients for its own share of every mini-batch,
+ * and the gradients are then summed across the ranks via allreduce.
+ * The sums can be started asynchronously (via startAllreduce) so that
+ * the communication of the gradients of one layer overlaps with the
+ * backward pass of the layers before it.  For example:
+ *
+ * \code
+ * Communicator comm(argc, argv);
+ * comm.startAllreduce(grad.data.data(), grad.data.size());
+ * // ... compute the other gradients ...
+ * comm.waitAll();
+ * \endcode
+ *
+ * All the methods (except rank and size) are collective operations
+ * and must be called by all ranks in the same order.  Only the thread
+ * that created the communicator may call them.
+ */
+class Communicator {
+public:
+    /**
+     * Initializes MPI (if enabled).  Only one communicator can be
+     * created in a program.
+     *
+     * \param[in,out] argc The number of command-line arguments passed
+     * to main.  MPI may remove the arguments it handles.
+     *
+     * \param[in,out] argv The command-line arguments passed to main.
+     */
+    Communicator(int& argc, char**& argv);
+
+    /** Waits for pending operations and shuts down MPI (if enabled) */
+    ~Communicator();
+
+    /**
+     * Returns the index of this process (0 to size() - 1).
+     *
+     * \return The index of this process.
+     */
+    size_t rank() const { return rankID; }
+
+    /**
+     * Returns the number of processes training together.
+     *
+     * \return The number of processes.  This is 1 if MPI is not used.
+     */
+    size_t size() const { return ranks; }
+
+    /**
+     * Returns true on the rank that reports progress and saves the
+     * results.
+     *
+     * \return True on rank 0.
+     */
+    bool isRoot() const { return rankID == 0; }
+
+    /**
+     * Starts adding up a given array of values across all ranks.  The
+     * array is replaced by the sum on every rank once waitAll returns.
+     * The array must not be used until then.
+     *
+     * \param[in,out] data The values to be summed.
+     *
+     * \param[in] count The number of values in data.
+     */
+    void startAllreduce(Val* data, const size_t count);
+
+    /**
+     * Gives MPI a chance to make progress on the pending sums without
+     * waiting for them.  This is called between the layers of the
+     * backward pass, as many MPI implementations only progress the
+     * non-blocking operations inside MPI calls.
+     */
+    void progress();
+
+    /** Waits for all the sums started via startAllreduce */
+    void waitAll();
+
+    /**
+     * Adds up a given array of values across all ranks and waits for
+     * the result.
+     *
+     * \param[in,out] data The values to be summed.
+     *
+     * \param[in] count The number of values in data.
+     */
+    void allreduce(Val* data, const size_t count);
+
+    /**
+     * Copies a given array of values from rank 0 to all the others.
+     *
+     * \param[in,out] data The values to be sent (on rank 0) or
+     * received (on the other ranks).
+     *
+     * \param[in] count The number of values in data.
+     */
+    void broadcast(Val* data, const size_t count);
+
+    // A communicator cannot be copied as MPI is initialized only once.
+    Communicator(const Communicator&) = delete;
+    Communicator& operator=(const Communicator&) = delete;
+
+private:
+    /** The index of this process */
+    size_t rankID = 0;
+
+    /** The number of processes */
+    size_t ranks = 1;
+
+#ifdef NNET_USE_MPI
+    /** The sums started by startAllreduce that are still pending */
+    std::vector<MPI_Request> pending;
+#endif
+};
+
+#endif
@@ -0,0 +1,394 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef DATA_REPOSITORY_CPP
+#define DATA_REPOSITORY_CPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "DataRepository.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// Reads a whole file into a buffer that is reused by each thread, so
+// that loading a list of images does not allocate a buffer per file.
+// Small files (such as the PGM images) are read in one system call.
+const std::string& readFile(const std::string& path) {
+    thread_local std::string buffer;
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        if (fd != -1) close(fd);
+        throw std::runtime_error("Unable to read " + path);
+    }
+    buffer.resize(info.st_size);
+    size_t done = 0;
+    while (done < buffer.size()) {
+        const ssize_t count = read(fd, &buffer[done], buffer.size() - done);
+        if (count <= 0) {
+            break;
+        }
+        done += count;
+    }
+    close(fd);
+    buffer.resize(done);
+    return buffer;
+}
+
+// Skips the whitespace and comments (from '#' to the end of the line)
+// in the header of a PGM file.
+const char* skipSpace(const char* pos, const char* end) {
+    while (pos < end) {
+        if (*pos == '#') {
+            while (pos < end && *pos != '\n') pos++;
+        } else if (std::isspace(static_cast<unsigned char>(*pos))) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// Parses a non-negative integer (after skipping whitespace) in a PGM
+// file.  Returns the position after the integer or nullptr if the
+// integer is missing.
+const char* parseInt(const char* pos, const char* end, int& value) {
+    pos = skipSpace(pos, end);
+    const auto [next, err] = std::from_chars(pos, end, value);
+    return (err == std::errc() && value >= 0) ? next : nullptr;
+}
+
+}  // namespace
+
+// Load a P2 (ASCII) or P5 (binary) PGM file into a column matrix with
+// normalized values.
+Matrix loadPGM(const std::string& path) {
+    const std::string& file = readFile(path);
+    const char *pos = file.data(), *end = pos + file.size();
+    // First read the header and dimensions
+    if (file.size() < 2 || pos[0] != 'P' || (pos[1] != '2' && pos[1] != '5')) {
+        throw std::runtime_error("Only P2 and P5 PGM formats are supported");
+    }
+    const bool binary = (pos[1] == '5');
+    int width = 0, height = 0, maxVal = 0;
+    pos = parseInt(pos + 2, end, width);
+    pos = (pos != nullptr) ? parseInt(pos, end, height) : nullptr;
+    pos = (pos != nullptr) ? parseInt(pos, end, maxVal) : nullptr;
+    if (pos == nullptr || maxVal <= 0 || maxVal > 65535) {
+        throw std::runtime_error("Invalid PGM header in " + path);
+    }
+    if (height != 0 && size_t(width) > SIZE_MAX / height) {
+        throw std::runtime_error("Invalid PGM header in " + path);
+    }
+    // Every pixel takes at least one byte, so check the size against
+    // the rest of the file before allocating the matrix.
+    const size_t count = size_t(width) * height;
+    const size_t remaining = end - pos;
+    const size_t bytes = (binary && maxVal > 255) ? 2 : 1;
+    if (count > remaining || (binary && count * bytes > remaining - 1)) {
+        throw std::runtime_error("Truncated PGM file " + path);
+    }
+    // Create a column matrix to read all of the data and normalize it
+    Matrix img(count, 1);
+    if (binary) {
+        // A single whitespace separates the header from the pixels,
+        // which use 2 (big-endian) bytes each if maxVal > 255.
+        const auto* pixels = reinterpret_cast<const uint8_t*>(pos + 1);
+        for (size_t i = 0; (i < count); i++) {
+            const int value = (bytes == 1) ? pixels[i] :
+                (pixels[2 * i] << 8) | pixels[2 * i + 1];
+            img.data[i] = Val(value) / maxVal;
+        }
+        return img;
+    }
+    for (size_t i = 0; (i < count); i++) {
+        int value = 0;
+        if ((pos = parseInt(pos, end, value)) == nullptr) {
+            throw std::runtime_error("Truncated PGM file " + path);
+        }
+        img.data[i] = Val(value) / maxVal;
+    }
+    return img;
+}
+
+// Returns the 10x1 expected output from the label in the file name.
+Matrix getExpectedDigitOutput(const std::string& path) {
+    // Path is of the form .../data/TrainingSet/test-image-6883_0.pgm
+    // We need to get to the last "_n" part and use 'n' as the label.
+    const auto labelPos = path.rfind('_') + 1;
+    // Now we know the index position of the 1-digit label.  Convert
+    // the character to integer for convenience.
+    const int label = path[labelPos] - '0';
+    // Now create the expected matrix with the just the value
+    // corresponding to the label set to 1.0
+    Matrix expected(10, 1, 0.0);
+    expected.data[label * 1] = 1.0;  // Just label should be 1.0
+    return expected;
+}
+
+
+// The magic numbers of the IDX3 (images) and IDX1 (labels) headers.
+constexpr uint32_t IdxImageMagic = 0x00000803, IdxLabelMagic = 0x00000801;
+
+// Helper method to write a 32-bit big-endian value as used in IDX files.
+static void writeBigEndian(std::ostream& os, const uint32_t val) {
+    const char bytes[4] = {char(val >> 24), char(val >> 16), char(val >> 8),
+                           char(val)};
+    os.write(bytes, sizeof(bytes));
+}
+
+// Helper method to read a 32-bit big-endian value as used in IDX files.
+static uint32_t readBigEndian(std::istream& is) {
+    unsigned char bytes[4] = {0, 0, 0, 0};
+    is.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+        (uint32_t(bytes[2]) << 8) | bytes[3];
+}
+
+// Helper method to decode a 32-bit big-endian value in a buffer.
+static uint32_t decodeBigEndian(const uint8_t* bytes) {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+        (uint32_t(bytes[2]) << 8) | bytes[3];
+}
+
+PackedDataset::PackedDataset(const std::string& file) {
+    const int fd = open(file.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        if (fd != -1) close(fd);
+        throw std::runtime_error("Unable to read " + file);
+    }
+    mappedSize = info.st_size;
+    // A shared read-only mapping lets concurrent jobs on a node share
+    // the same physical pages for the dataset.
+    mapping = (mappedSize > 0) ?
+        mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);  // The mapping remains valid after the file is closed
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("Unable to map " + file);
+    }
+    // Helper lambda to release the mapping on errors below.
+    const auto fail = [&](const std::string& msg) {
+        munmap(mapping, mappedSize);
+        throw std::runtime_error(msg + file);
+    };
+    // Validate the headers and locate the pixels and labels.
+    const uint8_t* bytes = static_cast<const uint8_t*>(mapping);
+    const size_t HdrSize = 16, LabelHdrSize = 8;
+    if (mappedSize < HdrSize || decodeBigEndian(bytes) != IdxImageMagic) {
+        fail("Not a packed dataset: ");
+    }
+    count = decodeBigEndian(bytes + 4);
+    rows  = decodeBigEndian(bytes + 8);
+    cols  = decodeBigEndian(bytes + 12);
+    if (count > mappedSize || rows * cols > mappedSize) {
+        fail("Invalid dimensions in packed dataset: ");
+    }
+    pixelData = bytes + HdrSize;
+    const size_t labelHdr = HdrSize + count * rows * cols;
+    if (mappedSize < labelHdr + LabelHdrSize + count ||
+        decodeBigEndian(bytes + labelHdr) != IdxLabelMagic ||
+        decodeBigEndian(bytes + labelHdr + 4) != count) {
+        fail("Missing labels in packed dataset: ");
+    }
+    labelData = bytes + labelHdr + LabelHdrSize;
+    // Ask the kernel to start reading the file in the background.
+    madvise(mapping, mappedSize, MADV_WILLNEED);
+}
+
+PackedDataset::PackedDataset(PackedDataset&& other) noexcept :
+    count(other.count), rows(other.rows), cols(other.cols),
+    mapping(other.mapping), mappedSize(other.mappedSize),
+    pixelData(other.pixelData), labelData(other.labelData),
+    replicas(std::move(other.replicas)) {
+    other.mapping = nullptr;
+    other.mappedSize = 0;
+}
+
+PackedDataset::~PackedDataset() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappedSize);
+        mapping = nullptr;
+    }
+}
+
+void PackedDataset::replicate(ThreadPool& pool) const {
+    replicas.build(pool, [this] {
+        return std::vector<uint8_t>(pixelData, pixelData + count * imageSize());
+    });
+}
+
+bool PackedDataset::isPacked(const std::string& file) {
+    std::ifstream is(file, std::ios::binary);
+    return is.good() && (readBigEndian(is) == IdxImageMagic) && is.good();
+}
+
+size_t PackedDataset::write(const std::string& path,
+                            const std::string& imgListFile,
+                            const std::string& outFile) {
+    // Load all the images, converting the normalized pixels back to
+    // bytes. All images must have the same dimensions.
+    const DatasetIndex index(path, imgListFile);
+    index.preload(Numa::cpuCount());
+    std::vector<uint8_t> pixels, labels;
+    const size_t imgSize = index.imageSize();
+    for (size_t i = 0; (i < index.size()); i++) {
+        const Matrix& img = index.image(i);
+        if (img.rows != imgSize) {
+            throw std::runtime_error("Image size mismatch: " + index.path(i));
+        }
+        for (const Val val : img.data) {
+            pixels.push_back(std::lround(val * 255));
+        }
+        labels.push_back(index.label(i));
+    }
+    // PGM images in the list are square (28x28 for MNIST).
+    const uint32_t side = std::lround(std::sqrt(imgSize));
+    if (side * side != imgSize) {
+        throw std::runtime_error("Only square images can be packed");
+    }
+    std::ofstream os(outFile, std::ios::binary);
+    writeBigEndian(os, IdxImageMagic);
+    writeBigEndian(os, labels.size());
+    writeBigEndian(os, side);
+    writeBigEndian(os, side);
+    os.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+    writeBigEndian(os, IdxLabelMagic);
+    writeBigEndian(os, labels.size());
+    os.write(reinterpret_cast<const char*>(labels.data()), labels.size());
+    if (!os.good()) {
+        throw std::runtime_error("Error writing: " + outFile);
+    }
+    return labels.size();
+}
+
+void PackedDataset::copyImage(const size_t idx, Matrix& batch,
+                              const size_t col) const {
+    assert(batch.rows == imageSize());
+    const uint8_t* px = pixels(idx);
+    for (size_t row = 0; (row < batch.rows); row++) {
+        batch.data[row * batch.cols + col] = px[row] / Val(255);
+    }
+}
+
+void PackedDataset::copySparseImage(const size_t idx,
+                                    SparseVector& sparse) const {
+    sparse.assign(pixels(idx), imageSize(), 255);
+}
+
+void PackedDataset::copyLabel(const size_t idx, Matrix& batch,
+                              const size_t col) const {
+    assert(batch.rows == 10);
+    for (size_t row = 0; (row < batch.rows); row++) {
+        batch.data[row * batch.cols + col] = (int(row) == label(idx));
+    }
+}
+
+DatasetIndex::DatasetIndex(const std::string& path,
+                           const std::string& imgListFile) {
+    std::ifstream fileList(imgListFile);
+    if (!fileList) {
+        throw std::runtime_error("Error reading: " + imgListFile);
+    }
+    for (std::string imgName; std::getline(fileList, imgName);) {
+        // Names are of the form test-image-6883_0.pgm, where the
+        // digit after the last '_' is the label.
+        const auto labelPos = imgName.rfind('_') + 1;
+        if (labelPos == 0 || labelPos >= imgName.size()) {
+            throw std::runtime_error("No label in file name: " + imgName);
+        }
+        paths.push_back(path + "/" + imgName);
+        labels.push_back(imgName[labelPos] - '0');
+    }
+    images.resize(paths.size());
+    loaded = std::make_unique<std::once_flag[]>(paths.size());
+}
+
+const Matrix& DatasetIndex::image(const size_t idx) const {
+    assert(idx < size());
+    NNET_PROFILE_COUNT(Profiler::Counter::CacheLookups, 1);
+    std::call_once(loaded[idx], [&] {
+        NNET_PROFILE_COUNT(Profiler::Counter::CacheMisses, 1);
+        images[idx] = loadPGM(paths[idx]);
+    });
+    return images[idx];
+}
+
+void DatasetIndex::preload(const size_t threads, const size_t count) const {
+    const size_t total = std::min(count, size());
+    // On a multi-socket machine the threads are spread across the
+    // nodes, so that the images they load (and first touch) are
+    // interleaved across the memory of all the nodes.
+    const Numa::Pinning pinning = (Numa::nodeCount() > 1) ?
+        Numa::Pinning::Scatter : Numa::Pinning::None;
+    ThreadPool pool(std::min(threads, total), Numa::cpuOrder(pinning));
+    // The threads claim the images one at a time, as the time to load
+    // each file varies.
+    std::atomic<size_t> next{0};
+    pool.run([&](const size_t) {
+        for (size_t idx; ((idx = next.fetch_add(1)) < total);) {
+            image(idx);
+        }
+    });
+}
+
+void DatasetIndex::copyImage(const size_t idx, Matrix& batch,
+                             const size_t col) const {
+    const Matrix& img = image(idx);
+    assert(batch.rows == img.rows);
+    for (size_t row = 0; (row < img.rows); row++) {
+        batch.data[row * batch.cols + col] = img.data[row];
+    }
+}
+
+void DatasetIndex::copySparseImage(const size_t idx,
+                                   SparseVector& sparse) const {
+    const Matrix& img = image(idx);
+    sparse.assign(img.data.data(), img.rows);
+}
+
+void DatasetIndex::copyLabel(const size_t idx, Matrix& batch,
+                             const size_t col) const {
+    assert(batch.rows == 10);
+    for (size_t row = 0; (row < batch.rows); row++) {
+        batch.data[row * batch.cols + col] = (int(row) == label(idx));
+    }
+}
+
+// The static cache of memory-mapped packed datasets.
+std::unordered_map<std::string, PackedDataset>&
+DataRepository::getDatasetStore() {
+    static std::unordered_map<std::string, PackedDataset> datasetStore;
+    return datasetStore;
+}
+
+const PackedDataset& DataRepository::fetchDataset(const std::string& file) {
+    auto& store = getDatasetStore();
+    {
+        std::lock_guard<std::mutex> lock(getMutex());
+        if (auto it = store.find(file); it != store.end()) {
+            return it->second;
+        }
+    }
+    // Map the file without holding the lock (as in fetchImage).  If
+    // another thread mapped the same file, emplace keeps its mapping.
+    PackedDataset dataset(file);
+    std::lock_guard<std::mutex> lock(getMutex());
+    auto [pos, _] = store.emplace(file, std::move(dataset));
+    return pos->second;
+}
+
+#endif
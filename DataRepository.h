@@ -0,0 +1,508 @@
+#ifndef DATA_REPOSITORY_H
+#define DATA_REPOSITORY_H
+
+/** \file DataRepository.h Loading and caching of the MNIST images.
+
+    This file contains the helper methods to load PGM images and their
+    labels, the DataRepository that caches them across epochs, and the
+    PackedDataset that stores a whole set of images in one binary file.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Matrix.h"
+#include "Numa.h"
+#include "Profiler.h"
+#include "SparseVector.h"
+
+/**
+ * Helper method to load a PGM data file into a 1-D matrix that can be
+ * supplied as training data to a NeuralNet.  Both the ASCII (P2) and
+ * binary (P5) formats are supported.  The file is read in one system
+ * call and parsed without iostreams, as parsing is the dominant cost
+ * of the first epoch.  An exception is thrown if the file cannot be
+ * read or is not a valid PGM file.
+ *
+ * \param[in] path The path from where the PGM file is to be loaded.
+ *
+ * \return A nx1 matrix with each row of the matrix corresponding to a
+ * pixel in the image.
+ */
+Matrix loadPGM(const std::string& path);
+
+/**
+ * Helper method to compute the expected output for a given image.
+ * The expected output is determined from the last digit in a given
+ * file name.  For example, if the path is test-image-6883_0.pgm, this
+ * method extracts the last "0" in the file name and uses that as the
+ * expected digit.  It This method returns a 10x1 matrix with the
+ * entry corresponding to the given digit to be set to 1.
+ *
+ * \paran[in] path The path to the PGM file from where the actual digit is to be extracted.
+ */
+Matrix getExpectedDigitOutput(const std::string& path);
+
+/**
+ * A set of images (and their labels) packed into a single binary
+ * file.  Loading one such file is much faster than loading tens of
+ * thousands of small ASCII PGM files.  The file is laid out as an IDX
+ * image file (the format used by the original MNIST distribution)
+ * followed by an IDX label file:
+ *
+ * <ul>
+ * <li>The IDX3 header: the 32-bit magic number 0x00000803 followed
+ * by the 32-bit image count, rows, and columns (all big-endian).</li>
+ *
+ * <li>The pixels as unsigned bytes (0 to 255), row-by-row for each
+ * image.</li>
+ *
+ * <li>The IDX1 header: the 32-bit magic number 0x00000801 followed by
+ * the 32-bit label count.</li>
+ *
+ * <li>The labels (digits 0 to 9) as unsigned bytes.</li>
+ * </ul>
+ *
+ * Consequently, standard IDX readers can read the images from the
+ * file as-is.  The file is memory-mapped (read-only) rather than read
+ * into memory.  So images are paged in on first use, are not copied,
+ * and take about 1/8th of the memory that a Matrix of doubles takes.
+ */
+class PackedDataset {
+public:
+    /**
+     * Memory-maps a packed dataset from a given file.
+     *
+     * \param[in] file The path to the packed dataset.  An exception
+     * is thrown if the file cannot be read or is not in the expected
+     * format.
+     */
+    explicit PackedDataset(const std::string& file);
+
+    /**
+     * The destructor unmaps the file.
+     */
+    ~PackedDataset();
+
+    /** A dataset is not copyable as it owns the mapping of the file */
+    PackedDataset(const PackedDataset&) = delete;
+
+    /** A dataset is not assignable as it owns the mapping of the file */
+    PackedDataset& operator=(const PackedDataset&) = delete;
+
+    /**
+     * Move constructor to transfer the mapping to a new dataset (for
+     * example, when it is stored in the DataRepository).
+     *
+     * \param[in,out] other The dataset whose mapping is moved.
+     */
+    PackedDataset(PackedDataset&& other) noexcept;
+
+    /**
+     * Packs a list of PGM images into a single binary file.
+     *
+     * \param[in] path The prefix path to the location where the images
+     * are actually stored.
+     *
+     * \param[in] imgListFile The file with the list of images (for
+     * example, TrainingSetList.txt) to be packed.
+     *
+     * \param[in] outFile The packed dataset file to be created.
+     *
+     * \return The number of images written to the file.
+     */
+    static size_t write(const std::string& path,
+                        const std::string& imgListFile,
+                        const std::string& outFile);
+
+    /**
+     * Checks whether a given file is a packed dataset (rather than a
+     * text file listing PGM images) based on its magic number.
+     *
+     * \param[in] file The path to the file to be checked.
+     *
+     * \return Returns true if the file has the IDX3 magic number.
+     */
+    static bool isPacked(const std::string& file);
+
+    /**
+     * Returns the number of images in the dataset.
+     *
+     * \return The number of images.
+     */
+    size_t size() const { return count; }
+
+    /**
+     * Returns the number of pixels in each image.
+     *
+     * \return The number of pixels (rows * cols) in each image.
+     */
+    size_t imageSize() const { return rows * cols; }
+
+    /**
+     * Returns the (digit) label for a given image.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \return The digit label for the image.
+     */
+    int label(const size_t idx) const { return labelData[idx]; }
+
+    /**
+     * Returns the raw pixels of a given image.  If the pixels have been
+     * replicated (see replicate), the copy on the node of the calling
+     * thread is used.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \return Pointer to the imageSize() pixels of the image.
+     */
+    const uint8_t* pixels(const size_t idx) const {
+        const std::vector<uint8_t>* local = replicas.local();
+        return ((local != nullptr) ? local->data() : pixelData) +
+            idx * imageSize();
+    }
+
+    /**
+     * Copies the pixels of this dataset to each of the other NUMA nodes
+     * on which the threads of a given pool run (see Numa::Replicated),
+     * so that those threads read the images from their own node.  This
+     * does nothing on a machine with a single node.  This method must
+     * be called before the threads use the dataset.
+     *
+     * \param[in] pool The (pinned) threads that will read the images.
+     */
+    void replicate(ThreadPool& pool) const;
+
+    /**
+     * Copies a given image, with pixels normalized to the range 0 to
+     * 1.0 (as done by loadPGM), into a column of a batch matrix.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \param[out] batch The batch with imageSize() rows to be updated.
+     *
+     * \param[in] col The column in the batch to be set.
+     */
+    void copyImage(const size_t idx, Matrix& batch, const size_t col) const;
+
+    /**
+     * Copies the non-zero pixels of a given image (normalized as by
+     * copyImage) into a sparse vector.  This is faster than copyImage
+     * as most pixels are zero.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \param[out] sparse The sparse vector to be set.
+     */
+    void copySparseImage(const size_t idx, SparseVector& sparse) const;
+
+    /**
+     * Sets a given column of a batch matrix to the expected output
+     * (as returned by getExpectedDigitOutput) for a given image.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \param[out] batch The batch with 10 rows to be updated.
+     *
+     * \param[in] col The column in the batch to be set.
+     */
+    void copyLabel(const size_t idx, Matrix& batch, const size_t col) const;
+
+private:
+    /** The number of images in the dataset */
+    size_t count = 0;
+
+    /** The number of rows in each image */
+    size_t rows = 0;
+
+    /** The number of columns in each image */
+    size_t cols = 0;
+
+    /** The start of the memory-mapped file */
+    void* mapping = nullptr;
+
+    /** The size of the memory-mapped file in bytes */
+    size_t mappedSize = 0;
+
+    /** The pixels of all the images (within the mapped file) */
+    const uint8_t* pixelData = nullptr;
+
+    /** The label for each image (within the mapped file) */
+    const uint8_t* labelData = nullptr;
+
+    /** The copies of the pixels on the other NUMA nodes, if any */
+    mutable Numa::Replicated<std::vector<uint8_t>> replicas;
+};
+
+
+
+/**
+ * An in-memory index of a list of PGM images (for example, the images
+ * in TrainingSetList.txt) that is built once and then reused in every
+ * epoch.  Each image is identified by its integer position in the
+ * list.  The full paths are resolved and the labels (held as bytes)
+ * are extracted from the file names when the index is built.  The
+ * images themselves are loaded on first use and kept in memory, so
+ * that later epochs do not need any string operations or hashing.
+ * This class has the same interface as PackedDataset, so the two can
+ * be used interchangeably for training and assessment.
+ */
+class DatasetIndex {
+public:
+    /**
+     * Builds the index from a given list of images.
+     *
+     * \param[in] path The prefix path to the location where the images
+     * are actually stored.
+     *
+     * \param[in] imgListFile The file with the list of images.  An
+     * exception is thrown if the file cannot be read.
+     */
+    DatasetIndex(const std::string& path, const std::string& imgListFile);
+
+    /**
+     * Returns the number of images in the index.
+     *
+     * \return The number of images.
+     */
+    size_t size() const { return paths.size(); }
+
+    /**
+     * Returns the number of pixels in each image.  This is the size
+     * of the first image, which is loaded if needed.
+     *
+     * \return The number of pixels in each image.
+     */
+    size_t imageSize() const { return empty() ? 0 : image(0).rows; }
+
+    /**
+     * Returns the (digit) label for a given image.
+     *
+     * \param[in] idx The index of the image in the list.
+     *
+     * \return The digit label for the image.
+     */
+    int label(const size_t idx) const { return labels[idx]; }
+
+    /**
+     * Returns the full path to a given image.
+     *
+     * \param[in] idx The index of the image in the list.
+     *
+     * \return The full path to the PGM file.
+     */
+    const std::string& path(const size_t idx) const { return paths[idx]; }
+
+    /**
+     * Returns a given image, loading it on first use.  This method is
+     * thread-safe and each image is loaded exactly once.
+     *
+     * \param[in] idx The index of the image in the list.
+     *
+     * \return The nx1 matrix with the normalized pixels of the image.
+     */
+    const Matrix& image(const size_t idx) const;
+
+    /**
+     * Loads (in parallel) the images that have not been loaded yet,
+     * so that later calls to image do not have to wait for the files.
+     * This method is thread-safe.  An exception is thrown if an image
+     * cannot be loaded.
+     *
+     * \param[in] threads The number of threads used to load the
+     * images.  Values less than 1 are treated as 1.
+     *
+     * \param[in] count The number of images (from the start of the
+     * list) to be loaded.  By default, all the images are loaded.
+     */
+    void preload(const size_t threads, const size_t count = -1) const;
+
+    /**
+     * Copies a given image into a column of a batch matrix.
+     *
+     * \param[in] idx The index of the image in the list.
+     *
+     * \param[out] batch The batch with imageSize() rows to be updated.
+     *
+     * \param[in] col The column in the batch to be set.
+     */
+    void copyImage(const size_t idx, Matrix& batch, const size_t col) const;
+
+    /**
+     * Copies the non-zero pixels of a given image (normalized as by
+     * copyImage) into a sparse vector.  This is faster than copyImage
+     * as most pixels are zero.
+     *
+     * \param[in] idx The index of the image in the dataset.
+     *
+     * \param[out] sparse The sparse vector to be set.
+     */
+    void copySparseImage(const size_t idx, SparseVector& sparse) const;
+
+    /**
+     * Sets a given column of a batch matrix to the expected output
+     * (as returned by getExpectedDigitOutput) for a given image.
+     *
+     * \param[in] idx The index of the image in the list.
+     *
+     * \param[out] batch The batch with 10 rows to be updated.
+     *
+     * \param[in] col The column in the batch to be set.
+     */
+    void copyLabel(const size_t idx, Matrix& batch, const size_t col) const;
+
+private:
+    /** Returns true if the list of images is empty */
+    bool empty() const { return paths.empty(); }
+
+    /** The full path to each image */
+    std::vector<std::string> paths;
+
+    /** The digit label of each image */
+    std::vector<uint8_t> labels;
+
+    /** The images that have been loaded so far */
+    mutable std::vector<Matrix> images;
+
+    /** Flags to ensure each image is loaded exactly once */
+    mutable std::unique_ptr<std::once_flag[]> loaded;
+};
+
+
+/**
+ * DataRepository: A caching layer that stores loaded images and labels
+ * to avoid redundant file I/O operations across multiple epochs.
+ */
+class DataRepository {
+public:
+    /**
+     * Fetches an image from the cache or loads it from disk if not cached.
+     * 
+     * \param[in] fullpath The full path to the PGM image file.
+     * 
+     * \return A const reference to the cached Matrix containing the image data.
+     *
+     * \note This method is thread-safe.  Images are loaded without
+     * holding the lock so that different threads load in parallel.
+     */
+    static const Matrix& fetchImage(const std::string& fullpath) {
+        auto& store = getImageStore();
+        NNET_PROFILE_COUNT(Profiler::Counter::CacheLookups, 1);
+        {
+            std::lock_guard<std::mutex> lock(getMutex());
+            if (auto it = store.find(fullpath); it != store.end())
+                return it->second;
+        }
+        NNET_PROFILE_COUNT(Profiler::Counter::CacheMisses, 1);
+        Matrix img = loadPGM(fullpath);
+        // If another thread loaded the same image, emplace keeps its copy
+        std::lock_guard<std::mutex> lock(getMutex());
+        auto [pos, _] = store.emplace(fullpath, std::move(img));
+        return pos->second;
+    }
+
+    /**
+     * Fetches a label matrix from the cache or generates it if not cached.
+     * 
+     * \param[in] filename The image filename used to extract the expected digit label.
+     * 
+     * \return A const reference to the cached Matrix containing the label data.
+     *
+     * \note This method is thread-safe.
+     */
+    static const Matrix& fetchLabel(const std::string& filename) {
+        auto& store = getLabelStore();
+        std::lock_guard<std::mutex> lock(getMutex());
+        if (auto it = store.find(filename); it != store.end())
+            return it->second;
+
+        Matrix lbl = getExpectedDigitOutput(filename);
+        auto [pos, _] = store.emplace(filename, std::move(lbl));
+        return pos->second;
+    }
+
+    /**
+     * Fetches a packed dataset that has been memory-mapped earlier or
+     * maps it now.  The dataset is mapped only once per process and
+     * images are then accessed by index via non-owning views into
+     * the mapped file.  Hence there is no per-image copy or hashing
+     * and the pages are shared with other processes using the same
+     * file on a node.
+     *
+     * \param[in] file The path to the packed dataset file.
+     *
+     * \return A const reference to the memory-mapped dataset.
+     */
+    static const PackedDataset& fetchDataset(const std::string& file);
+
+    /**
+     * Clears all cached images and labels from memory.
+     * This can be used to free memory between experiments or test runs.
+     * The packed datasets remain mapped (see releaseDatasets), as
+     * references to them may still be in use.
+     */
+    static void reset() {
+        std::lock_guard<std::mutex> lock(getMutex());
+        getImageStore().clear();
+        getLabelStore().clear();
+    }
+
+    /**
+     * Unmaps all the packed datasets returned by fetchDataset.  This
+     * invalidates every reference to them (and to their images), so
+     * it must only be called once none of them are in use.
+     */
+    static void releaseDatasets() {
+        std::lock_guard<std::mutex> lock(getMutex());
+        getDatasetStore().clear();
+    }
+
+private:
+    /**
+     * Returns the mutex that guards the image, label, and dataset
+     * caches.  The caches are node-based maps, so references returned
+     * by the fetch methods remain valid while other threads add
+     * entries.
+     *
+     * \return A reference to the mutex used by the fetch methods.
+     */
+    static std::mutex& getMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /**
+     * Returns a reference to the static image cache.
+     * 
+     * \return A reference to the unordered_map storing cached images.
+     */
+    static std::unordered_map<std::string, Matrix>& getImageStore() {
+        static std::unordered_map<std::string, Matrix> imageStore;
+        return imageStore;
+    }
+
+    /**
+     * Returns a reference to the static label cache.
+     * 
+     * \return A reference to the unordered_map storing cached labels.
+     */
+    static std::unordered_map<std::string, Matrix>& getLabelStore() {
+        static std::unordered_map<std::string, Matrix> labelStore;
+        return labelStore;
+    }
+
+    /**
+     * Returns a reference to the static cache of packed datasets.
+     *
+     * \return A reference to the unordered_map storing mapped datasets.
+     */
+    static std::unordered_map<std::string, PackedDataset>& getDatasetStore();
+};
+
+#endif
@@ -0,0 +1,539 @@
+#ifndef FIXED_NEURAL_NET_H
+#define FIXED_NEURAL_NET_H
+
+/** \file FixedNeuralNet.h A neural network with a compile-time topology.
+
+    This file contains a version of NeuralNet in which the number of
+    neurons on each layer is a template parameter.  All the weights,
+    biases, and scratch buffers are fixed-size arrays stored inside
+    the object (rather than separately allocated matrices), and the
+    loops over the (small) hidden and output layers have constant trip
+    counts so the compiler fully unrolls them and keeps the values in
+    registers.  The network is trained one image at a time (i.e., the
+    same as NeuralNet::learn) and shares the checkpoint format with
+    NeuralNet.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include "Matrix.h"
+#include "MatrixKernels.h"
+#include "NeuralNet.h"
+#include "Profiler.h"
+#include "SparseVector.h"
+
+/**
+ * The weights, biases, and scratch buffers of one layer of a
+ * FixedNeuralNet.  The arrays are aligned to cache lines (as in
+ * Matrix).  The weights are stored row-major with one row per neuron,
+ * except for the first layer of the network (see FixedNeuralNet).
+ *
+ * \tparam In The number of inputs to this layer.
+ *
+ * \tparam Out The number of neurons in this layer.
+ */
+template<size_t In, size_t Out>
+struct FixedLayer {
+    /** The weights, Out rows of In values each */
+    alignas(64) std::array<Val, Out * In> weights{};
+
+    /** The bias for each neuron */
+    alignas(64) std::array<Val, Out> biases{};
+
+    /** The activations for the image being learnt */
+    alignas(64) std::array<Val, Out> activations{};
+
+    /** The errors (deltas) for the image being learnt */
+    alignas(64) std::array<Val, Out> deltas{};
+};
+
+/**
+ * A sigmoid network with quadratic cost (the configuration used by
+ * the main program) with a compile-time topology.  For example,
+ * FixedNeuralNet<784, 30, 10> is the same as NeuralNet({784, 30,
+ * 10}).  The two classes can be converted into each other and hence
+ * checkpoints saved by one can be loaded by the other.
+ *
+ * Most of the pixels of a digit are zero.  So the first layer works
+ * on the sparse (index/value) form of each image (see SparseVector)
+ * and skips the zero pixels in both the forward pass and the weight
+ * update.  To make this efficient, the weights of the first layer
+ * are stored input-major (one contiguous row with the weights of all
+ * the neurons for each pixel), so that each non-zero pixel is a
+ * single SIMD axpy of that row.  Dense images are converted to the
+ * sparse form on the fly for learning, while predict runs the first
+ * layer densely (one unrolled axpy per pixel).  The short rows of the
+ * later layers use loops with constant trip counts that are fully
+ * unrolled.  Learning updates the weights of each layer in the same
+ * pass that computes its gradients, so no gradient matrices are
+ * stored.
+ *
+ * The object holds all the weights (about 190 KB for 784-30-10) and
+ * so it should be allocated on the heap (for example, via
+ * std::make_unique) rather than on the stack.
+ *
+ * \tparam Sizes The number of neurons on each layer including the
+ * inputs.
+ */
+template<size_t... Sizes>
+class FixedNeuralNet {
+public:
+    /** The number of neurons on each layer */
+    static constexpr std::array<size_t, sizeof...(Sizes)> LayerSizes =
+        {Sizes...};
+
+    /** The number of layers with weights (i.e., excluding the inputs) */
+    static constexpr size_t LayerCount = sizeof...(Sizes) - 1;
+
+    /** The number of inputs (pixels) */
+    static constexpr size_t Inputs = LayerSizes[0];
+
+    /** The number of outputs */
+    static constexpr size_t Outputs = LayerSizes[LayerCount];
+
+    static_assert(LayerCount >= 1, "A network needs at least 2 layers");
+
+    /**
+     * Creates a network with all weights and biases set to zero (the
+     * same as the sigmoid layers of NeuralNet).
+     */
+    FixedNeuralNet() = default;
+
+    /**
+     * Copies the weights and biases of a dynamic network.
+     *
+     * \param[in] net The network to be copied.  An exception is
+     * thrown if its layer sizes are not the same as Sizes or if it
+     * does not use the sigmoid and the quadratic cost.
+     */
+    explicit FixedNeuralNet(const NeuralNet& net) {
+        if (net.layerSizes.data.size() != LayerSizes.size() ||
+            !std::equal(LayerSizes.begin(), LayerSizes.end(),
+                        net.layerSizes.data.begin())) {
+            throw std::invalid_argument("The layer sizes of the network "
+                                        "do not match");
+        }
+        if (net.loss != Loss::Quadratic ||
+            std::any_of(net.layerActivations.begin(),
+                        net.layerActivations.end(), [](const Activation act) {
+                            return act != Activation::Sigmoid; })) {
+            throw std::invalid_argument("Only sigmoid networks with the "
+                                        "quadratic cost are supported");
+        }
+        forEachLayer([&](auto lyr, auto& layer) {
+            const Matrix& w = net.weights[lyr];
+            for (size_t row = 0; (row < w.rows); row++) {
+                for (size_t col = 0; (col < w.cols); col++) {
+                    layer.weights[weightIndex<lyr>(row, col)] =
+                        w.data[row * w.cols + col];
+                }
+            }
+            std::copy_n(net.biases[lyr].data.begin(), layer.biases.size(),
+                        layer.biases.begin());
+        });
+    }
+
+    /**
+     * Returns a dynamic network with the same weights and biases.
+     *
+     * \return The equivalent NeuralNet.
+     */
+    NeuralNet toNeuralNet() const {
+        NeuralNet net(std::vector<int>(LayerSizes.begin(), LayerSizes.end()));
+        forEachLayer([&](auto lyr, const auto& layer) {
+            Matrix& w = net.weights[lyr];
+            for (size_t row = 0; (row < w.rows); row++) {
+                for (size_t col = 0; (col < w.cols); col++) {
+                    w.data[row * w.cols + col] =
+                        layer.weights[weightIndex<lyr>(row, col)];
+                }
+            }
+            std::copy(layer.biases.begin(), layer.biases.end(),
+                      net.biases[lyr].data.begin());
+        });
+        return net;
+    }
+
+    /**
+     * Saves this network in the checkpoint format of NeuralNet (see
+     * NeuralNet::saveCheckpoint).
+     *
+     * \param[in] file The path of the checkpoint file.
+     */
+    void saveCheckpoint(const std::string& file) const {
+        toNeuralNet().saveCheckpoint(file);
+    }
+
+    /**
+     * Loads a network from a checkpoint saved by NeuralNet or by
+     * this class.  An exception is thrown if the checkpoint cannot be
+     * read or its network does not match this class.
+     *
+     * \param[in] file The path of the checkpoint file.
+     *
+     * \return The network from the checkpoint.
+     */
+    static FixedNeuralNet loadCheckpoint(const std::string& file) {
+        return FixedNeuralNet(NeuralNet::loadCheckpoint(file));
+    }
+
+    /**
+     * Updates the weights and biases to help the network recognize a
+     * given image.  This is the same as NeuralNet::learn.
+     *
+     * \param[in] inputs The Inputs x 1 matrix with the pixels.
+     *
+     * \param[in] expected The Outputs x 1 matrix with the expected
+     * outputs.
+     *
+     * \param[in] eta The learning rate.
+     */
+    void learn(const Matrix& inputs, const Matrix& expected,
+               const Val eta = 0.3) {
+        assert(inputs.data.size() == Inputs);
+        assert(expected.data.size() == Outputs);
+        learn(inputs.data.data(), expected.data.data(), eta);
+    }
+
+    /**
+     * Updates the weights and biases to help the network recognize a
+     * given image.
+     *
+     * \param[in] inputs The Inputs pixels of the image.
+     *
+     * \param[in] expected The Outputs expected outputs.
+     *
+     * \param[in] eta The learning rate.
+     */
+    void learn(const Val* inputs, const Val* expected, const Val eta = 0.3) {
+        sparseInputs.assign(inputs, Inputs);
+        learn(sparseInputs, expected, eta);
+    }
+
+    /**
+     * Updates the weights and biases to help the network recognize a
+     * given image in sparse form (for example, from the
+     * copySparseImage method of the datasets).
+     *
+     * \param[in] inputs The non-zero pixels of the image.  The size of
+     * the vector must be Inputs.
+     *
+     * \param[in] expected The Outputs expected outputs.
+     *
+     * \param[in] eta The learning rate.
+     */
+    void learn(const SparseVector& inputs, const Val* expected,
+               const Val eta = 0.3) {
+        assert(inputs.size == Inputs);
+        const SparseView in{inputs.indices.data(), inputs.values.data(),
+                            inputs.nonZeros()};
+        // Forward pass recording the activations of every layer.
+        {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Forward);
+            forEachLayer([&](auto lyr, auto& layer) {
+                constexpr size_t Lyr = decltype(lyr)::value;
+                if constexpr (Lyr == 0) {
+                    forwardInputs(in, layer.activations.data());
+                } else {
+                    forward<Lyr>(layerInput<Lyr>(),
+                                 layer.activations.data());
+                }
+            });
+        }
+        // The weights are updated during the backward pass, so the
+        // Backward phase includes the updates.
+        NNET_PROFILE_SCOPE(Profiler::Phase::Backward);
+        // The error of the output layer for the quadratic cost.
+        auto& last = std::get<LayerCount - 1>(layers);
+        for (size_t row = 0; (row < Outputs); row++) {
+            last.deltas[row] = last.activations[row] - expected[row];
+        }
+        sigmoidGrad(last.activations.data(), last.deltas.data(), Outputs);
+        backward<LayerCount - 1>(in, eta);
+    }
+
+    /**
+     * Classifies a given image.  This method does not modify the
+     * network and only uses buffers on the stack.  So it can be
+     * called concurrently from many threads.
+     *
+     * \param[in] pixels The Inputs normalized pixels of the image.
+     *
+     * \return The index of the output with the highest activation
+     * (i.e., the digit).
+     */
+    int predict(const float* pixels) const {
+        return predictInputs(pixels);
+    }
+
+    /**
+     * Classifies a given image in sparse form.  Like the dense
+     * version, this method is thread-safe.
+     *
+     * \param[in] pixels The non-zero pixels of the image.  The size of
+     * the vector must be Inputs.
+     *
+     * \return The index of the output with the highest activation
+     * (i.e., the digit).
+     */
+    int predict(const SparseVector& pixels) const {
+        assert(pixels.size == Inputs);
+        return predictInputs(SparseView{pixels.indices.data(),
+                                        pixels.values.data(),
+                                        pixels.nonZeros()});
+    }
+
+protected:
+    /** The non-zero values of an input image */
+    struct SparseView {
+        const uint32_t* indices;
+        const Val* values;
+        size_t count;
+    };
+
+    /** The number of inputs to a given layer */
+    template<size_t Lyr>
+    static constexpr size_t InputsOf = LayerSizes[Lyr];
+
+    /** The number of neurons in a given layer */
+    template<size_t Lyr>
+    static constexpr size_t OutputsOf = LayerSizes[Lyr + 1];
+
+    /** Helper to build the tuple of layers from an index sequence */
+    template<typename Seq>
+    struct LayerTuple;
+
+    template<size_t... Lyr>
+    struct LayerTuple<std::index_sequence<Lyr...>> {
+        using type = std::tuple<FixedLayer<InputsOf<Lyr>, OutputsOf<Lyr>>...>;
+    };
+
+    /** The type of the layers of this network */
+    using Layers =
+        typename LayerTuple<std::make_index_sequence<LayerCount>>::type;
+
+    /**
+     * Calls fn(lyr, layer) for each layer, where lyr is an
+     * std::integral_constant with the index of the layer (so that it
+     * can be used as a template argument).
+     */
+    template<typename Fn>
+    void forEachLayer(const Fn& fn) {
+        forEachLayer(fn, std::make_index_sequence<LayerCount>());
+    }
+
+    template<typename Fn>
+    void forEachLayer(const Fn& fn) const {
+        forEachLayer(fn, std::make_index_sequence<LayerCount>());
+    }
+
+    template<typename Fn, size_t... Lyr>
+    void forEachLayer(const Fn& fn, std::index_sequence<Lyr...>) {
+        (fn(std::integral_constant<size_t, Lyr>(), std::get<Lyr>(layers)),
+         ...);
+    }
+
+    template<typename Fn, size_t... Lyr>
+    void forEachLayer(const Fn& fn, std::index_sequence<Lyr...>) const {
+        (fn(std::integral_constant<size_t, Lyr>(), std::get<Lyr>(layers)),
+         ...);
+    }
+
+    /**
+     * Returns the index of the weight of a given neuron for a given
+     * input.  The first layer is stored input-major and the others
+     * are stored row-major.
+     */
+    template<size_t Lyr>
+    static constexpr size_t weightIndex(const size_t row, const size_t col) {
+        return (Lyr == 0) ? col * OutputsOf<Lyr> + row
+                          : row * InputsOf<Lyr> + col;
+    }
+
+    /** Returns the inputs to a layer (after the first) being learnt */
+    template<size_t Lyr>
+    const Val* layerInput() const {
+        static_assert(Lyr > 0, "The first layer uses the sparse inputs");
+        return std::get<Lyr - 1>(layers).activations.data();
+    }
+
+    /** Returns the dot product of two arrays with N values */
+    template<size_t N>
+    static Val dot(const Val* a, const Val* b) {
+        if constexpr (N >= 64) {
+            return matrixKernels().dot(a, b, N);
+        } else {
+            Val sum = 0;
+            for (size_t i = 0; (i < N); i++) {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+    }
+
+    /** Computes y += alpha * x for arrays with N values */
+    template<size_t N>
+    static void axpy(const Val alpha, const Val* x, Val* y) {
+        if constexpr (N >= 64) {
+            matrixKernels().axpy(alpha, x, y, N);
+        } else {
+            for (size_t i = 0; (i < N); i++) {
+                y[i] += alpha * x[i];
+            }
+        }
+    }
+
+    /**
+     * The forward pass for the first layer, using the sparse inputs:
+     * out = sigmoid(b + sum of value * (row of weights for its index)).
+     *
+     * \param[in] in The non-zero inputs.
+     *
+     * \param[out] out The activations of the first layer.
+     */
+    void forwardInputs(const SparseView& in, Val* out) const {
+        constexpr size_t Rows = OutputsOf<0>;
+        const auto& layer = std::get<0>(layers);
+        const MatrixKernels& kernels = matrixKernels();
+        std::copy(layer.biases.begin(), layer.biases.end(), out);
+        for (size_t i = 0; (i < in.count); i++) {
+            kernels.axpy(in.values[i], &layer.weights[in.indices[i] * Rows],
+                         out, Rows);
+        }
+        kernels.sigmoid(out, out, Rows);
+    }
+
+    /**
+     * The dense forward pass for the first layer.  As the weights are
+     * stored input-major, this is one fully unrolled axpy of the
+     * weights of each pixel (without any conversion or branches).
+     *
+     * \param[in] pixels The Inputs pixels of the image.
+     *
+     * \param[out] out The activations of the first layer.
+     */
+    void forwardInputs(const float* pixels, Val* out) const {
+        constexpr size_t Rows = OutputsOf<0>;
+        const auto& layer = std::get<0>(layers);
+        std::copy(layer.biases.begin(), layer.biases.end(), out);
+        for (size_t i = 0; (i < Inputs); i++) {
+            axpy<Rows>(pixels[i], &layer.weights[i * Rows], out);
+        }
+        matrixKernels().sigmoid(out, out, Rows);
+    }
+
+    /** Multiplies the deltas by the derivative of the sigmoid */
+    static void sigmoidGrad(const Val* act, Val* delta, const size_t n) {
+        matrixKernels().sigmoidGrad(act, delta, n);
+    }
+
+    /**
+     * The forward pass for one layer: out = sigmoid(W . in + b).
+     *
+     * \param[in] in The inputs to the layer.
+     *
+     * \param[out] out The activations of the layer.
+     */
+    template<size_t Lyr>
+    void forward(const Val* in, Val* out) const {
+        constexpr size_t Cols = InputsOf<Lyr>, Rows = OutputsOf<Lyr>;
+        const auto& layer = std::get<Lyr>(layers);
+        for (size_t row = 0; (row < Rows); row++) {
+            out[row] = layer.biases[row] +
+                dot<Cols>(&layer.weights[row * Cols], in);
+        }
+        matrixKernels().sigmoid(out, out, Rows);
+    }
+
+    /** The forward pass of predict from a given layer onwards */
+    template<size_t Lyr>
+    void predictLayers(const Val* in, Val* outputs) const {
+        if constexpr (Lyr + 1 == LayerCount) {
+            forward<Lyr>(in, outputs);
+        } else {
+            alignas(64) std::array<Val, OutputsOf<Lyr>> out;
+            forward<Lyr>(in, out.data());
+            predictLayers<Lyr + 1>(out.data(), outputs);
+        }
+    }
+
+    /**
+     * Classifies an image given its pixels (as a const float*) or its
+     * non-zero pixels (as a SparseView).
+     */
+    template<typename Input>
+    int predictInputs(const Input& in) const {
+        alignas(64) std::array<Val, Outputs> out;
+        if constexpr (LayerCount == 1) {
+            forwardInputs(in, out.data());
+        } else {
+            alignas(64) std::array<Val, OutputsOf<0>> hidden;
+            forwardInputs(in, hidden.data());
+            predictLayers<1>(hidden.data(), out.data());
+        }
+        return std::max_element(out.begin(), out.end()) - out.begin();
+    }
+
+    /**
+     * The backward pass from a given layer down to the first one.  The
+     * errors of the previous layer are computed (with the current
+     * weights) before the weights of this layer are updated in place.
+     *
+     * \param[in] inputs The non-zero pixels of the image being learnt.
+     *
+     * \param[in] eta The learning rate.
+     */
+    template<size_t Lyr>
+    void backward(const SparseView& inputs, const Val eta) {
+        constexpr size_t Cols = InputsOf<Lyr>, Rows = OutputsOf<Lyr>;
+        auto& layer = std::get<Lyr>(layers);
+        if constexpr (Lyr > 0) {
+            // deltas[lyr - 1] = transpose(W) . deltas[lyr], as a sum of
+            // the rows of W scaled by the deltas.
+            auto& prev = std::get<Lyr - 1>(layers);
+            prev.deltas.fill(0);
+            for (size_t row = 0; (row < Rows); row++) {
+                axpy<Cols>(layer.deltas[row], &layer.weights[row * Cols],
+                           prev.deltas.data());
+            }
+            sigmoidGrad(prev.activations.data(), prev.deltas.data(), Cols);
+        }
+        for (size_t row = 0; (row < Rows); row++) {
+            layer.biases[row] -= eta * layer.deltas[row];
+        }
+        if constexpr (Lyr == 0) {
+            // The gradient of the (input-major) row of weights for each
+            // non-zero input is input * deltas.  The rows for the zero
+            // inputs do not change.
+            const MatrixKernels& kernels = matrixKernels();
+            for (size_t i = 0; (i < inputs.count); i++) {
+                kernels.axpy(-eta * inputs.values[i], layer.deltas.data(),
+                             &layer.weights[inputs.indices[i] * Rows], Rows);
+            }
+        } else {
+            // The gradient of each row of weights is delta * input.
+            const Val* in = layerInput<Lyr>();
+            for (size_t row = 0; (row < Rows); row++) {
+                axpy<Cols>(-eta * layer.deltas[row], in,
+                           &layer.weights[row * Cols]);
+            }
+            backward<Lyr - 1>(inputs, eta);
+        }
+    }
+
+private:
+    /** The weights, biases, and buffers of each layer */
+    Layers layers;
+
+    /** The sparse form of the dense image being learnt */
+    SparseVector sparseInputs;
+};
+
+#endif
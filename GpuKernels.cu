@@ -0,0 +1,176 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef GPU_KERNELS_CU
+#define GPU_KERNELS_CU
+
+#include <cuda_runtime.h>
+#include "GpuKernels.h"
+
+namespace {
+
+// The number of threads in each block of the element-wise kernels.
+constexpr unsigned BlockSize = 256;
+
+// Returns the number of blocks needed for n threads.
+unsigned blocks(const size_t n) {
+    return (n + BlockSize - 1) / BlockSize;
+}
+
+__global__ void gatherImagesKernel(const uint8_t* pixels,
+                                   const uint32_t* order, const size_t count,
+                                   const size_t imgSize, Val* batch) {
+    // One thread per value of the batch, so that the writes coalesce.
+    const size_t i = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i < count * imgSize) {
+        const size_t row = i / count, col = i % count;
+        batch[i] = pixels[order[col] * imgSize + row] / Val(255);
+    }
+}
+
+__global__ void gatherLabelsKernel(const uint8_t* labels,
+                                   const uint32_t* order, const size_t count,
+                                   const size_t outputs, Val* expected) {
+    const size_t i = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i < count * outputs) {
+        const size_t row = i / count, col = i % count;
+        expected[i] = (labels[order[col]] == row) ? 1 : 0;
+    }
+}
+
+__global__ void addBiasActivateKernel(Val* z, const Val* bias,
+                                      const size_t rows, const size_t cols,
+                                      const Activation act) {
+    const size_t i = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i >= rows * cols) {
+        return;
+    }
+    const Val val = z[i] + bias[i / cols];
+    switch (act) {
+    case Activation::ReLU: z[i] = (val > 0) ? val : Val(0);   break;
+    case Activation::Tanh: z[i] = tanh(val);                  break;
+    default:               z[i] = 1 / (1 + exp(-val));        break;
+    }
+}
+
+__global__ void addBiasSoftmaxKernel(Val* z, const Val* bias,
+                                     const size_t rows, const size_t cols) {
+    // One thread per image, as the output layer is small.
+    const size_t col = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (col >= cols) {
+        return;
+    }
+    // Subtract the maximum so that exp cannot overflow.
+    Val maxVal = z[col] + bias[0];
+    for (size_t row = 0; (row < rows); row++) {
+        const Val val = (z[row * cols + col] += bias[row]);
+        maxVal = (val > maxVal) ? val : maxVal;
+    }
+    Val sum = 0;
+    for (size_t row = 0; (row < rows); row++) {
+        Val& val = z[row * cols + col];
+        val = exp(val - maxVal);
+        sum += val;
+    }
+    for (size_t row = 0; (row < rows); row++) {
+        z[row * cols + col] /= sum;
+    }
+}
+
+__global__ void outputErrorKernel(const Val* act, const Val* expected,
+                                  Val* delta, const size_t n) {
+    const size_t i = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i < n) {
+        delta[i] = act[i] - expected[i];
+    }
+}
+
+__global__ void mulDerivativeKernel(const Val* act, Val* delta,
+                                    const size_t n, const Activation fn) {
+    const size_t i = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i >= n) {
+        return;
+    }
+    switch (fn) {
+    case Activation::ReLU: delta[i] = (act[i] > 0) ? delta[i] : Val(0); break;
+    case Activation::Tanh: delta[i] *= 1 - act[i] * act[i];            break;
+    default:               delta[i] *= act[i] * (1 - act[i]);          break;
+    }
+}
+
+__global__ void updateBiasesKernel(Val* bias, const Val* delta,
+                                   const size_t rows, const size_t cols,
+                                   const Val rate) {
+    // One thread per neuron, as a batch has only tens of images.
+    const size_t row = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (row < rows) {
+        Val sum = 0;
+        for (size_t col = 0; (col < cols); col++) {
+            sum += delta[row * cols + col];
+        }
+        bias[row] -= rate * sum;
+    }
+}
+
+__global__ void argmaxColumnsKernel(const Val* outputs, const size_t rows,
+                                    const size_t cols, int* labels) {
+    const size_t col = size_t(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (col < cols) {
+        int best = 0;
+        for (size_t row = 1; (row < rows); row++) {
+            if (outputs[row * cols + col] > outputs[best * cols + col]) {
+                best = row;
+            }
+        }
+        labels[col] = best;
+    }
+}
+
+}  // namespace
+
+void gpu::gatherImages(const uint8_t* pixels, const uint32_t* order,
+                       const size_t count, const size_t imgSize, Val* batch) {
+    gatherImagesKernel<<<blocks(count * imgSize), BlockSize>>>(
+        pixels, order, count, imgSize, batch);
+}
+
+void gpu::gatherLabels(const uint8_t* labels, const uint32_t* order,
+                       const size_t count, const size_t outputs,
+                       Val* expected) {
+    gatherLabelsKernel<<<blocks(count * outputs), BlockSize>>>(
+        labels, order, count, outputs, expected);
+}
+
+void gpu::addBiasActivate(Val* z, const Val* bias, const size_t rows,
+                          const size_t cols, const Activation act) {
+    if (act == Activation::Softmax) {
+        addBiasSoftmaxKernel<<<blocks(cols), BlockSize>>>(z, bias, rows,
+                                                          cols);
+    } else {
+        addBiasActivateKernel<<<blocks(rows * cols), BlockSize>>>(
+            z, bias, rows, cols, act);
+    }
+}
+
+void gpu::outputError(const Val* act, const Val* expected, Val* delta,
+                      const size_t n) {
+    outputErrorKernel<<<blocks(n), BlockSize>>>(act, expected, delta, n);
+}
+
+void gpu::mulDerivative(const Val* act, Val* delta, const size_t n,
+                        const Activation fn) {
+    mulDerivativeKernel<<<blocks(n), BlockSize>>>(act, delta, n, fn);
+}
+
+void gpu::updateBiases(Val* bias, const Val* delta, const size_t rows,
+                       const size_t cols, const Val rate) {
+    updateBiasesKernel<<<blocks(rows), BlockSize>>>(bias, delta, rows, cols,
+                                                    rate);
+}
+
+void gpu::argmaxColumns(const Val* outputs, const size_t rows,
+                        const size_t cols, int* labels) {
+    argmaxColumnsKernel<<<blocks(cols), BlockSize>>>(outputs, rows, cols,
+                                                     labels);
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef GPU_KERNELS_H
+#define GPU_KERNELS_H
+
+/** \file GpuKernels.h The CUDA kernels used by GpuNet.
+
+    This file declares the host functions that launch the element-wise
+    and per-column CUDA kernels used by GpuNet.  The matrix products
+    are done via cuBLAS (in GpuNet.cpp), so these kernels cover the
+    rest of a training step: assembling a batch from a resident packed
+    dataset, the activations and their derivatives, and the bias
+    updates.  All the pointers are to device memory and the matrices
+    use the same row-major layout (one image per column) as Matrix.
+    Each function launches its kernel on the default stream and
+    returns without waiting for it.
+
+    The kernels are in GpuKernels.cu, which is compiled (via nvcc)
+    only when the program is built with -DNNET_USE_CUDA.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include "Activations.h"
+
+/** The launchers for the CUDA kernels */
+namespace gpu {
+
+/**
+ * Assembles a batch of images (one per column) from the pixels of a
+ * packed dataset, normalizing them as done by PackedDataset::copyImage.
+ *
+ * \param[in] pixels The pixels of all the images in the dataset.
+ *
+ * \param[in] order The indexes of the images in the batch.
+ *
+ * \param[in] count The number of images in the batch.
+ *
+ * \param[in] imgSize The number of pixels in each image.
+ *
+ * \param[out] batch The imgSize x count batch.
+ */
+void gatherImages(const uint8_t* pixels, const uint32_t* order,
+                  const size_t count, const size_t imgSize, Val* batch);
+
+/**
+ * Sets the expected outputs (one-hot, one per column) for a batch of
+ * images from the labels of a packed dataset.
+ *
+ * \param[in] labels The labels of all the images in the dataset.
+ *
+ * \param[in] order The indexes of the images in the batch.
+ *
+ * \param[in] count The number of images in the batch.
+ *
+ * \param[in] outputs The number of outputs of the network.
+ *
+ * \param[out] expected The outputs x count expected outputs.
+ */
+void gatherLabels(const uint8_t* labels, const uint32_t* order,
+                  const size_t count, const size_t outputs, Val* expected);
+
+/**
+ * Adds the biases to the weighted inputs of a layer and replaces them
+ * with the activations (as done by NeuralNet::feedForward).
+ *
+ * \param[in,out] z The rows x cols weighted inputs of the layer.
+ *
+ * \param[in] bias The rows biases of the layer.
+ *
+ * \param[in] rows The number of neurons in the layer.
+ *
+ * \param[in] cols The number of images in the batch.
+ *
+ * \param[in] act The activation function of the layer.
+ */
+void addBiasActivate(Val* z, const Val* bias, const size_t rows,
+                     const size_t cols, const Activation act);
+
+/**
+ * Computes the error of the outputs (a - y) for a batch.
+ *
+ * \param[in] act The activations of the output layer.
+ *
+ * \param[in] expected The expected outputs.
+ *
+ * \param[out] delta The errors of the outputs.
+ *
+ * \param[in] n The number of values in each of the arrays.
+ */
+void outputError(const Val* act, const Val* expected, Val* delta,
+                 const size_t n);
+
+/**
+ * Multiplies errors by the derivative of an activation function,
+ * computed from the activations (see Activations.h).
+ *
+ * \param[in] act The activations of the layer.
+ *
+ * \param[in,out] delta The errors to be multiplied.
+ *
+ * \param[in] n The number of values in each of the arrays.
+ *
+ * \param[in] fn The activation function of the layer.  It must not
+ * be softmax.
+ */
+void mulDerivative(const Val* act, Val* delta, const size_t n,
+                   const Activation fn);
+
+/**
+ * Subtracts rate times the sum of each row of the errors (i.e., the
+ * gradient of each bias summed over the batch) from the biases.
+ *
+ * \param[in,out] bias The rows biases to be updated.
+ *
+ * \param[in] delta The rows x cols errors of the layer.
+ *
+ * \param[in] rows The number of neurons in the layer.
+ *
+ * \param[in] cols The number of images in the batch.
+ *
+ * \param[in] rate The learning rate divided by the batch size.
+ */
+void updateBiases(Val* bias, const Val* delta, const size_t rows,
+                  const size_t cols, const Val rate);
+
+/**
+ * Finds the index of the maximum output for each image in a batch.
+ *
+ * \param[in] outputs The rows x cols outputs of the network.
+ *
+ * \param[in] rows The number of outputs.
+ *
+ * \param[in] cols The number of images in the batch.
+ *
+ * \param[out] labels The cols indexes of the maximum outputs.
+ */
+void argmaxColumns(const Val* outputs, const size_t rows, const size_t cols,
+                   int* labels);
+
+}  // namespace gpu
+
+#endif
@@ -0,0 +1,261 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef GPU_NET_CPP
+#define GPU_NET_CPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "GpuNet.h"
+
+#ifdef NNET_USE_CUDA
+
+#include "GpuKernels.h"
+
+namespace {
+
+// Throws an exception if a CUDA call failed.
+void check(const cudaError_t err) {
+    if (err != cudaSuccess) {
+        throw std::runtime_error(std::string("CUDA error: ") +
+                                 cudaGetErrorString(err));
+    }
+}
+
+// Throws an exception if a cuBLAS call failed.
+void check(const cublasStatus_t status) {
+    if (status != CUBLAS_STATUS_SUCCESS) {
+        throw std::runtime_error("cuBLAS error " +
+                                 std::to_string(int(status)));
+    }
+}
+
+// The matrix product (C = alpha * op(A) * op(B) + beta * C) for each
+// type of Val.  cuBLAS uses column-major matrices, so the row-major
+// matrices are passed as their transposes (see GpuNet::forward).
+void gemm(cublasHandle_t handle, const cublasOperation_t opA,
+          const cublasOperation_t opB, const int m, const int n, const int k,
+          const double alpha, const double* a, const int lda, const double* b,
+          const int ldb, const double beta, double* c, const int ldc) {
+    check(cublasDgemm(handle, opA, opB, m, n, k, &alpha, a, lda, b, ldb,
+                      &beta, c, ldc));
+}
+
+void gemm(cublasHandle_t handle, const cublasOperation_t opA,
+          const cublasOperation_t opB, const int m, const int n, const int k,
+          const float alpha, const float* a, const int lda, const float* b,
+          const int ldb, const float beta, float* c, const int ldc) {
+    check(cublasSgemm(handle, opA, opB, m, n, k, &alpha, a, lda, b, ldb,
+                      &beta, c, ldc));
+}
+
+}  // namespace
+
+template<typename T>
+void GpuNet::DeviceBuffer<T>::reserve(const size_t n) {
+    if (n > count) {
+        cudaFree(ptr);
+        ptr   = nullptr;
+        count = 0;
+        check(cudaMalloc(reinterpret_cast<void**>(&ptr), n * sizeof(T)));
+        count = n;
+    }
+}
+
+template<typename T>
+void GpuNet::DeviceBuffer<T>::upload(const T* host, const size_t n) {
+    reserve(n);
+    check(cudaMemcpy(ptr, host, n * sizeof(T), cudaMemcpyHostToDevice));
+}
+
+template<typename T>
+void GpuNet::DeviceBuffer<T>::download(T* host, const size_t n) const {
+    check(cudaMemcpy(host, ptr, n * sizeof(T), cudaMemcpyDeviceToHost));
+}
+
+bool GpuNet::isAvailable() {
+    int devices = 0;
+    return cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+}
+
+GpuNet::GpuNet(const NeuralNet& net) : hostNet(net) {
+    if (!isAvailable()) {
+        throw std::runtime_error("No GPU is available");
+    }
+    for (const Val size : net.layerSizes.data) {
+        sizes.push_back(size_t(size));
+    }
+    const size_t lyrCount = net.weights.size();
+    weights.resize(lyrCount);
+    biases.resize(lyrCount);
+    activations.resize(lyrCount);
+    deltas.resize(lyrCount);
+    for (size_t lyr = 0; (lyr < lyrCount); lyr++) {
+        weights[lyr].upload(net.weights[lyr].data.data(),
+                            net.weights[lyr].data.size());
+        biases[lyr].upload(net.biases[lyr].data.data(),
+                           net.biases[lyr].data.size());
+    }
+    // The handle is created last, as the destructor (which frees it)
+    // is not called if an upload above throws.
+    check(cublasCreate(&handle));
+}
+
+GpuNet::~GpuNet() {
+    cublasDestroy(handle);
+}
+
+const GpuNet::DeviceDataset&
+GpuNet::resident(const PackedDataset& dataset) {
+    if (auto it = datasets.find(&dataset); it != datasets.end()) {
+        return it->second;
+    }
+    // The pixels and labels are contiguous in a packed dataset.  The
+    // copy is cached only once both uploads succeed.
+    DeviceDataset dev;
+    dev.pixels.upload(dataset.pixels(0), dataset.size() * dataset.imageSize());
+    std::vector<uint8_t> labels(dataset.size());
+    for (size_t i = 0; (i < dataset.size()); i++) {
+        labels[i] = dataset.label(i);
+    }
+    dev.labels.upload(labels.data(), labels.size());
+    return datasets.emplace(&dataset, std::move(dev)).first->second;
+}
+
+void GpuNet::reserve(const size_t cols) {
+    if (cols <= batchCapacity) {
+        return;
+    }
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        activations[lyr].reserve(sizes[lyr + 1] * cols);
+        deltas[lyr].reserve(sizes[lyr + 1] * cols);
+    }
+    inputs.reserve(sizes[0] * cols);
+    expected.reserve(sizes.back() * cols);
+    labels.reserve(cols);
+    batchCapacity = cols;
+}
+
+void GpuNet::forward(const size_t cols) {
+    // A row-major rows x cols matrix is a column-major cols x rows
+    // matrix.  So Z = W * X is computed as Z^T = X^T * W^T.
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        const Val* in = (lyr == 0) ? inputs.data() :
+            activations[lyr - 1].data();
+        const int rows = sizes[lyr + 1], inSize = sizes[lyr];
+        gemm(handle, CUBLAS_OP_N, CUBLAS_OP_N, cols, rows, inSize, 1, in,
+             cols, weights[lyr].data(), inSize, 0, activations[lyr].data(),
+             cols);
+        gpu::addBiasActivate(activations[lyr].data(), biases[lyr].data(),
+                             rows, cols, hostNet.layerActivations[lyr]);
+    }
+}
+
+void GpuNet::learnBatch(const size_t cols, const Val rate) {
+    forward(cols);
+    const size_t lastLyr = weights.size() - 1;
+    const size_t outputs = sizes.back() * cols;
+    gpu::outputError(activations[lastLyr].data(), expected.data(),
+                     deltas[lastLyr].data(), outputs);
+    if (hostNet.loss == Loss::Quadratic) {
+        gpu::mulDerivative(activations[lastLyr].data(),
+                           deltas[lastLyr].data(), outputs,
+                           hostNet.layerActivations[lastLyr]);
+    }
+    for (size_t lyr = lastLyr + 1; (lyr-- > 0);) {
+        const Val* in = (lyr == 0) ? inputs.data() :
+            activations[lyr - 1].data();
+        const int rows = sizes[lyr + 1], inSize = sizes[lyr];
+        if (lyr > 0) {
+            // Propagate the errors with the weights before the update:
+            // D^T = delta^T * W, using the transpose of W^T.
+            gemm(handle, CUBLAS_OP_N, CUBLAS_OP_T, cols, inSize, rows, 1,
+                 deltas[lyr].data(), cols, weights[lyr].data(), inSize, 0,
+                 deltas[lyr - 1].data(), cols);
+            gpu::mulDerivative(activations[lyr - 1].data(),
+                               deltas[lyr - 1].data(), inSize * cols,
+                               hostNet.layerActivations[lyr - 1]);
+        }
+        // W -= rate * delta * X^T, computed as W^T -= rate * X * delta^T
+        // directly into the weights (so no gradients are stored).
+        gemm(handle, CUBLAS_OP_T, CUBLAS_OP_N, inSize, rows, cols, -rate, in,
+             cols, deltas[lyr].data(), cols, 1, weights[lyr].data(), inSize);
+        gpu::updateBiases(biases[lyr].data(), deltas[lyr].data(), rows, cols,
+                          rate);
+    }
+}
+
+void GpuNet::learn(const PackedDataset& dataset,
+                   const std::vector<size_t>& order, const size_t batchSize,
+                   const Val eta) {
+    const DeviceDataset& dev = resident(dataset);
+    const size_t perBatch = std::max<size_t>(batchSize, 1);
+    reserve(perBatch);
+    // The only copy to the device in an epoch is the order of images.
+    const std::vector<uint32_t> indexes(order.begin(), order.end());
+    this->order.upload(indexes.data(), indexes.size());
+    for (size_t start = 0; (start < indexes.size()); start += perBatch) {
+        const size_t size = std::min(perBatch, indexes.size() - start);
+        const uint32_t* batchOrder = this->order.data() + start;
+        gpu::gatherImages(dev.pixels.data(), batchOrder, size, sizes[0],
+                          inputs.data());
+        gpu::gatherLabels(dev.labels.data(), batchOrder, size, sizes.back(),
+                          expected.data());
+        learnBatch(size, eta / size);
+    }
+    check(cudaGetLastError());
+    check(cudaDeviceSynchronize());
+}
+
+std::vector<int> GpuNet::classifyBatch(const Matrix& inputs) {
+    reserve(inputs.cols);
+    this->inputs.upload(inputs.data.data(), inputs.data.size());
+    forward(inputs.cols);
+    gpu::argmaxColumns(activations.back().data(), sizes.back(), inputs.cols,
+                       labels.data());
+    check(cudaGetLastError());
+    std::vector<int> result(inputs.cols);
+    labels.download(result.data(), result.size());
+    return result;
+}
+
+NeuralNet GpuNet::toNeuralNet() const {
+    NeuralNet net = hostNet;
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        weights[lyr].download(net.weights[lyr].data.data(),
+                              net.weights[lyr].data.size());
+        biases[lyr].download(net.biases[lyr].data.data(),
+                             net.biases[lyr].data.size());
+    }
+    return net;
+}
+
+#else
+
+// Without CUDA there is no GPU to use, and a GpuNet cannot be created.
+
+bool GpuNet::isAvailable() {
+    return false;
+}
+
+GpuNet::GpuNet(const NeuralNet& net) : hostNet(net) {
+    throw std::runtime_error("GPU support requires building with "
+                             "-DNNET_USE_CUDA");
+}
+
+GpuNet::~GpuNet() {}
+
+void GpuNet::learn(const PackedDataset&, const std::vector<size_t>&,
+                   const size_t, const Val) {}
+
+std::vector<int> GpuNet::classifyBatch(const Matrix&) {
+    return {};
+}
+
+NeuralNet GpuNet::toNeuralNet() const {
+    return hostNet;
+}
+
+#endif
+
+#endif
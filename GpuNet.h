@@ -0,0 +1,233 @@
+#ifndef GPU_NET_H
+#define GPU_NET_H
+
+/** \file GpuNet.h A copy of a NeuralNet that is trained on a GPU.
+
+    This file contains an optional CUDA backend for training and
+    classification.  The weights and biases, and the packed datasets
+    used, stay resident in device memory across epochs.  So an epoch
+    only copies the (shuffled) order of the images to the device, and
+    each mini-batch is a handful of kernel launches (cuBLAS products
+    for the layers and the kernels in GpuKernels.h), without any
+    per-sample copies between the host and the device.
+
+    The GPU is used only if the program is compiled with
+    -DNNET_USE_CUDA (and linked with GpuKernels.cu, the CUDA runtime,
+    and cuBLAS).  Otherwise, isAvailable returns false and the CPU
+    path (the default) is used.  So the rest of the code does not need
+    any #ifdefs.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DataRepository.h"
+#include "Matrix.h"
+#include "NeuralNet.h"
+
+#ifdef NNET_USE_CUDA
+#include <cublas_v2.h>
+#include <cuda_runtime.h>
+#endif
+
+/**
+ * A network (with the same layers, activations, and loss as a given
+ * NeuralNet) whose weights and biases are kept on a GPU.  Training
+ * uses packed datasets, which are copied to the device the first time
+ * they are used.  For example:
+ *
+ * \code
+ * GpuNet gpuNet(net);
+ * for (int epoch = 0; (epoch < 10); epoch++) {
+ *     gpuNet.learn(trainSet, shuffledOrder, 32);
+ * }
+ * net = gpuNet.toNeuralNet();
+ * \endcode
+ *
+ * The methods of this class are not thread-safe.
+ */
+class GpuNet {
+public:
+    /**
+     * Returns true if the program was built with CUDA support and a
+     * GPU is present.
+     *
+     * \return True if a GpuNet can be created.
+     */
+    static bool isAvailable();
+
+    /**
+     * Copies the weights and biases of a given network to the GPU.  An
+     * exception is thrown if a GPU cannot be used (see isAvailable).
+     *
+     * \param[in] net The network to be copied.
+     */
+    explicit GpuNet(const NeuralNet& net);
+
+    /** Frees the device memory used by the network and the datasets */
+    ~GpuNet();
+
+    /** The network is not copyable as it owns device memory */
+    GpuNet(const GpuNet&) = delete;
+
+    /** The network is not assignable as it owns device memory */
+    GpuNet& operator=(const GpuNet&) = delete;
+
+    /**
+     * Trains the network for one epoch using the images of a packed
+     * dataset in a given order (as done by NeuralNet::learnBatch for
+     * each mini-batch).  The dataset is copied to the device on first
+     * use and then remains there.
+     *
+     * \param[in] dataset The dataset with the training images.  It
+     * must remain valid while this network exists.
+     *
+     * \param[in] order The indexes of the images to be used, in the
+     * order in which they are used.
+     *
+     * \param[in] batchSize The number of images in each mini-batch.  A
+     * batch size of 1 is the same as NeuralNet::learn.
+     *
+     * \param[in] eta The learning rate.
+     */
+    void learn(const PackedDataset& dataset, const std::vector<size_t>& order,
+               const size_t batchSize, const Val eta = 0.3);
+
+    /**
+     * Classifies a batch of images (as done by NeuralNet::classifyBatch).
+     *
+     * \param[in] inputs The input images, one image per column.
+     *
+     * \return The index of the maximum output for each image.
+     */
+    std::vector<int> classifyBatch(const Matrix& inputs);
+
+    /**
+     * Returns a copy of this network, with the weights and biases
+     * copied back from the GPU.  This is used for assessment and to
+     * save checkpoints.
+     *
+     * \return The network as a NeuralNet.
+     */
+    NeuralNet toNeuralNet() const;
+
+private:
+    /** The network copied to the GPU, whose topology is reused
+        (and whose values are updated) by toNeuralNet */
+    NeuralNet hostNet;
+
+#ifdef NNET_USE_CUDA
+    /**
+     * An array in device memory.  The array can be moved but not
+     * copied.
+     *
+     * \tparam T The type of the values in the array.
+     */
+    template<typename T>
+    class DeviceBuffer {
+    public:
+        DeviceBuffer() = default;
+
+        ~DeviceBuffer() { cudaFree(ptr); }
+
+        DeviceBuffer(DeviceBuffer&& other) noexcept :
+            ptr(other.ptr), count(other.count) {
+            other.ptr   = nullptr;
+            other.count = 0;
+        }
+
+        DeviceBuffer& operator=(DeviceBuffer&& other) noexcept {
+            std::swap(ptr, other.ptr);
+            std::swap(count, other.count);
+            return *this;
+        }
+
+        /** Ensures the array has room for at least n values */
+        void reserve(const size_t n);
+
+        /** Copies n values from the host to the start of the array */
+        void upload(const T* host, const size_t n);
+
+        /** Copies n values from the start of the array to the host */
+        void download(T* host, const size_t n) const;
+
+        T* data() { return ptr; }
+        const T* data() const { return ptr; }
+
+    private:
+        T* ptr = nullptr;
+        size_t count = 0;
+    };
+
+    /** A packed dataset that is resident in device memory */
+    struct DeviceDataset {
+        DeviceBuffer<uint8_t> pixels;
+        DeviceBuffer<uint8_t> labels;
+    };
+
+    /**
+     * Returns the copy of a given dataset in device memory, copying the
+     * dataset to the device on first use.
+     */
+    const DeviceDataset& resident(const PackedDataset& dataset);
+
+    /**
+     * Sizes the activations and errors for a given batch size.
+     *
+     * \param[in] cols The number of images in each batch.
+     */
+    void reserve(const size_t cols);
+
+    /**
+     * The forward pass for a batch of images in the inputs buffer.  The
+     * activations of each layer are left in the activations buffers.
+     *
+     * \param[in] cols The number of images in the batch.
+     */
+    void forward(const size_t cols);
+
+    /**
+     * The forward and backward passes for the batch in the inputs and
+     * expected buffers, updating the weights and biases of each layer
+     * as soon as its errors have been propagated.
+     *
+     * \param[in] cols The number of images in the batch.
+     *
+     * \param[in] rate The learning rate divided by the batch size.
+     */
+    void learnBatch(const size_t cols, const Val rate);
+
+    /** The handle used for the cuBLAS calls */
+    cublasHandle_t handle = nullptr;
+
+    /** The number of neurons in each layer (starting with the inputs) */
+    std::vector<size_t> sizes;
+
+    /** The weights and biases of each layer */
+    std::vector<DeviceBuffer<Val>> weights, biases;
+
+    /** The activations and errors of each layer for a batch */
+    std::vector<DeviceBuffer<Val>> activations, deltas;
+
+    /** The current batch of images and their expected outputs */
+    DeviceBuffer<Val> inputs, expected;
+
+    /** The order of the images used in an epoch */
+    DeviceBuffer<uint32_t> order;
+
+    /** The labels computed by classifyBatch */
+    DeviceBuffer<int> labels;
+
+    /** The number of images for which the buffers are sized */
+    size_t batchCapacity = 0;
+
+    /** The datasets that have been copied to the device */
+    std::unordered_map<const PackedDataset*, DeviceDataset> datasets;
+#endif
+};
+
+#endif
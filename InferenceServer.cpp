@@ -0,0 +1,235 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef INFERENCE_SERVER_CPP
+#define INFERENCE_SERVER_CPP
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "DataRepository.h"
+#include "InferenceServer.h"
+
+namespace {
+
+// Writes all of a given string to a file descriptor.  Returns false
+// if the other end has been closed.
+bool writeAll(const int fd, const std::string& str) {
+    for (size_t done = 0; (done < str.size());) {
+        const ssize_t count = write(fd, str.data() + done, str.size() - done);
+        if (count <= 0) {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+}  // namespace
+
+InferenceServer::InferenceServer(const NeuralNet& net, const size_t maxBatch,
+                                 const std::chrono::microseconds maxWait) :
+    net(net), maxBatch(std::max<size_t>(maxBatch, 1)), maxWait(maxWait),
+    worker(&InferenceServer::classifyRequests, this) {
+}
+
+InferenceServer::~InferenceServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    pending.notify_all();
+    worker.join();
+}
+
+std::future<int> InferenceServer::submit(Matrix image) {
+    if (image.rows != net.inputSize() || image.cols != 1) {
+        throw std::runtime_error("Image does not have " +
+                                 std::to_string(net.inputSize()) +
+                                 " pixels");
+    }
+    Request req{std::move(image), std::promise<int>(),
+                std::chrono::steady_clock::now()};
+    std::future<int> digit = req.digit.get_future();
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(req));
+    // The background thread only needs to know about the first
+    // request of a batch and about the batch being full.
+    if (queue.size() == 1 || queue.size() >= maxBatch) {
+        pending.notify_one();
+    }
+    return digit;
+}
+
+void InferenceServer::classifyRequests() {
+    std::vector<Request> batch;
+    Matrix inputs;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        pending.wait(lock, [&] { return stop || !queue.empty(); });
+        if (queue.empty()) {
+            return;  // Stopped with no pending requests.
+        }
+        // Give more requests a chance to be coalesced with the first
+        // one, up to its deadline.
+        const auto deadline = queue.front().arrival + maxWait;
+        pending.wait_until(lock, deadline, [&] {
+            return stop || queue.size() >= maxBatch; });
+        const size_t count = std::min(queue.size(), maxBatch);
+        batch.clear();
+        for (size_t i = 0; (i < count); i++) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        lock.unlock();
+        // Classify the batch without holding the lock, so that new
+        // requests can be queued meanwhile.
+        std::vector<int> digits;
+        try {
+            // Resize reuses the storage from the previous batch
+            inputs.resize(net.inputSize(), count);
+            for (size_t col = 0; (col < count); col++) {
+                const Matrix& img = batch[col].image;
+                for (size_t row = 0; (row < img.rows); row++) {
+                    inputs.data[row * count + col] = img.data[row];
+                }
+            }
+            digits = net.classifyBatch(inputs);
+        } catch (...) {
+            for (Request& req : batch) {
+                req.digit.set_exception(std::current_exception());
+            }
+        }
+        for (size_t i = 0; (i < digits.size()); i++) {
+            batch[i].digit.set_value(digits[i]);
+        }
+        lock.lock();
+        requestCount += count;
+        batchCount++;
+    }
+}
+
+Matrix InferenceServer::parseRequest(const std::string& line,
+                                     const std::string& imgPath) const {
+    if (line.find_first_of(" \t") == std::string::npos) {
+        // The line is the path of a PGM file.
+        return loadPGM(line[0] == '/' ? line : imgPath + "/" + line);
+    }
+    // The line has the normalized pixels.
+    std::istringstream is(line);
+    Matrix image(net.inputSize(), 1);
+    for (Val& pixel : image.data) {
+        if (!(is >> pixel)) {
+            throw std::runtime_error("Too few pixels in request");
+        }
+    }
+    if (Val extra; is >> extra) {
+        throw std::runtime_error("Too many pixels in request");
+    }
+    return image;
+}
+
+void InferenceServer::serve(const int inFd, const int outFd,
+                            const std::string& imgPath) {
+    // The response to each request is either a digit or an error.
+    std::vector<std::pair<std::future<int>, std::string>> responses;
+    std::string buffer;
+    char chunk[1 << 16];
+    bool open = true;
+    while (open) {
+        const ssize_t count = read(inFd, chunk, sizeof(chunk));
+        open = (count > 0);
+        buffer.append(chunk, std::max<ssize_t>(count, 0));
+        if (!open && !buffer.empty() && buffer.back() != '\n') {
+            buffer += '\n';  // The last request need not end in a newline.
+        }
+        // Submit all the complete requests read so far.
+        size_t start = 0;
+        for (size_t end; ((end = buffer.find('\n', start)) !=
+                          std::string::npos); start = end + 1) {
+            std::string line = buffer.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                responses.emplace_back(submit(parseRequest(line, imgPath)),
+                                       "");
+            } catch (const std::exception& e) {
+                responses.emplace_back(std::future<int>(), e.what());
+            }
+        }
+        buffer.erase(0, start);
+        // Now wait for the responses (in order) and send them at once.
+        std::string out;
+        for (auto& [digit, error] : responses) {
+            if (digit.valid()) {
+                try {
+                    out += std::to_string(digit.get()) + '\n';
+                    continue;
+                } catch (const std::exception& e) {
+                    error = e.what();
+                }
+            }
+            out += "error: " + error + '\n';
+        }
+        responses.clear();
+        if (!out.empty() && !writeAll(outFd, out)) {
+            return;  // The client has gone away.
+        }
+    }
+}
+
+void InferenceServer::listen(const int port, const std::string& imgPath) {
+    // Writing to a closed connection must not terminate the server.
+    std::signal(SIGPIPE, SIG_IGN);
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    if (sock == -1 ||
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                   sizeof(reuse)) != 0 ||
+        bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(sock, SOMAXCONN) != 0) {
+        if (sock != -1) close(sock);
+        throw std::runtime_error("Unable to listen on port " +
+                                 std::to_string(port));
+    }
+    while (true) {
+        const int conn = accept(sock, nullptr, nullptr);
+        if (conn == -1) {
+            continue;  // For example, the client reset the connection.
+        }
+        // The connections are served until the process is stopped, so
+        // their threads are never joined.
+        std::thread([this, conn, imgPath] {
+            serve(conn, conn, imgPath);
+            close(conn);
+        }).detach();
+    }
+}
+
+size_t InferenceServer::requests() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requestCount;
+}
+
+size_t InferenceServer::batches() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batchCount;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+/** \file InferenceServer.h Batched classification as a service.
+
+    This file contains a server that classifies images on behalf of
+    many concurrent clients.  Rather than running one matrix-vector
+    pass per request, the requests that arrive close together are
+    coalesced into micro-batches that are classified via the batched
+    (matrix-matrix) path of NeuralNet::classifyBatch.  Each request
+    waits at most a given time for its micro-batch to fill up, which
+    bounds the extra latency while giving a much higher throughput.
+
+    The requests are read from byte streams (stdin or TCP
+    connections) with one request per line and one response per line
+    (see serve).
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Matrix.h"
+#include "NeuralNet.h"
+
+/**
+ * A server that classifies images in micro-batches.  Requests are
+ * submitted from any number of threads and are classified by a
+ * background thread.  For example:
+ *
+ * \code
+ * InferenceServer server(net, 64, std::chrono::microseconds(500));
+ * std::future<int> digit = server.submit(loadPGM(path));
+ * std::cout << digit.get() << '\n';
+ * \endcode
+ *
+ * The background thread waits for the first pending request and then
+ * for up to maxWait (from the arrival of that request) for more
+ * requests, until maxBatch requests are pending.  All the pending
+ * requests (up to maxBatch) are then classified as one batch.
+ */
+class InferenceServer {
+public:
+    /**
+     * Creates the server and starts its background thread.
+     *
+     * \param[in] net The network used for classification.  The network
+     * must not be modified (or destroyed) while the server exists.
+     *
+     * \param[in] maxBatch The maximum number of images in each
+     * micro-batch.
+     *
+     * \param[in] maxWait The maximum time a request waits for other
+     * requests to be coalesced with it.  Zero classifies whatever
+     * requests are pending as soon as the background thread is free.
+     */
+    InferenceServer(const NeuralNet& net, const size_t maxBatch = 64,
+                    const std::chrono::microseconds maxWait =
+                    std::chrono::microseconds(1000));
+
+    /**
+     * Stops the background thread after classifying all the pending
+     * requests.
+     */
+    ~InferenceServer();
+
+    /** The server is not copyable as it owns a thread */
+    InferenceServer(const InferenceServer&) = delete;
+
+    /** The server is not assignable as it owns a thread */
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * Queues an image for classification.  This method is thread-safe.
+     *
+     * \param[in] image The normalized pixels of the image as a column
+     * matrix (as returned by loadPGM).  The number of rows must be the
+     * number of inputs of the network.
+     *
+     * \return The digit of the image, once it has been classified.  If
+     * classification fails, the future holds the exception instead.
+     */
+    std::future<int> submit(Matrix image);
+
+    /**
+     * Serves the requests read from a given file descriptor until the
+     * end of the input, writing the responses to another one.  Each
+     * request is a line with either the path of a PGM file (relative
+     * to imgPath, unless it starts with '/') or the normalized pixels
+     * of an image separated by spaces.  Each response is a line with
+     * the digit or "error: " followed by the reason.  The responses
+     * are in the order of the requests.  All the requests read at once
+     * are submitted before waiting for their responses, so that a
+     * client that sends many requests without waiting for responses
+     * gets them classified in batches.  This method may be called
+     * concurrently (for different connections).
+     *
+     * \param[in] inFd The file descriptor from which requests are read.
+     *
+     * \param[in] outFd The file descriptor to which responses are
+     * written.
+     *
+     * \param[in] imgPath The directory containing the PGM files.
+     */
+    void serve(const int inFd, const int outFd,
+               const std::string& imgPath = ".");
+
+    /**
+     * Accepts TCP connections on a given port and serves each one (via
+     * serve) in its own thread.  The requests of all the connections
+     * are coalesced together.  This method returns only if the port
+     * cannot be used, in which case an exception is thrown.
+     *
+     * \param[in] port The TCP port on which connections are accepted.
+     *
+     * \param[in] imgPath The directory containing the PGM files.
+     */
+    void listen(const int port, const std::string& imgPath = ".");
+
+    /**
+     * Returns the number of requests classified so far.
+     *
+     * \return The number of requests classified.
+     */
+    size_t requests() const;
+
+    /**
+     * Returns the number of micro-batches classified so far.  The
+     * average batch size is requests() / batches().
+     *
+     * \return The number of micro-batches.
+     */
+    size_t batches() const;
+
+private:
+    /** A request waiting to be classified */
+    struct Request {
+        /** The pixels of the image */
+        Matrix image;
+        /** The digit to be set when the image is classified */
+        std::promise<int> digit;
+        /** The time at which the request was submitted */
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    /**
+     * The method run by the background thread that classifies the
+     * requests in micro-batches until the server is destroyed.
+     */
+    void classifyRequests();
+
+    /**
+     * Converts a line of a request into an image.  An exception
+     * (std::runtime_error) is thrown if the line is invalid.
+     *
+     * \param[in] line The request line.
+     *
+     * \param[in] imgPath The directory containing the PGM files.
+     */
+    Matrix parseRequest(const std::string& line,
+                        const std::string& imgPath) const;
+
+    /** The network used for classification */
+    const NeuralNet& net;
+
+    /** The maximum number of images in each micro-batch */
+    const size_t maxBatch;
+
+    /** The maximum time a request waits for others to arrive */
+    const std::chrono::microseconds maxWait;
+
+    /** Mutex to coordinate access to the variables below */
+    mutable std::mutex mutex;
+
+    /** Used to notify the background thread of new requests */
+    std::condition_variable pending;
+
+    /** The requests waiting to be classified, in arrival order */
+    std::deque<Request> queue;
+
+    /** Flag to indicate that the background thread should stop */
+    bool stop = false;
+
+    /** The number of requests classified so far */
+    size_t requestCount = 0;
+
+    /** The number of micro-batches classified so far */
+    size_t batchCount = 0;
+
+    /** The background thread classifying the requests */
+    std::thread worker;
+};
+
+#endif
@@ -5,12 +5,21 @@
 
 #include <cassert>
 #include <vector>
+#include <algorithm>
 #include "Matrix.h"
+#include "MatrixKernels.h"
 
 Matrix::Matrix(const size_t row, const size_t col, const Val initVal) :
     data(row * col, initVal), rows(row), cols(col) {
 }
 
+Matrix Matrix::uninitialized(const size_t row, const size_t col) {
+    // The PoolAllocator does not zero the values added by resize.
+    Matrix result;
+    result.resize(row, col);
+    return result;
+}
+
 // Operator to write the matrix to a given output stream
 std::ostream& operator<<(std::ostream& os, const Matrix& matrix) {
     // Print the number of rows and columns to ease reading
@@ -44,29 +53,254 @@ std::istream& operator>>(std::istream& is, Matrix& matrix) {
     return is;
 }
 
-Matrix Matrix::dot(const Matrix& rhs) const {
-    // Ensure the dimensions are compatible for matrix multiplication.
-    assert(cols == rhs.rows);
-    // Setup the result matrix
-    const auto mWidth = rhs.cols, width = cols;
-    Matrix result(rows, mWidth);
-    // Do the actual matrix multiplication
+// The following anonymous namespace contains the cache-blocked GEMM
+// engine used by Matrix::dot.  The approach is the one used by most
+// BLAS libraries: the operands are split into blocks that fit in the
+// L2 (for A) and L1 (for B) caches, each block is copied (packed) into
+// a contiguous buffer in the order the micro-kernel reads it, and the
+// SIMD micro-kernel (see MatrixKernels.h) computes a small tile of
+// the result in registers.  The operands are described via row and
+// column strides, so that transposed operands can be read in place.
+namespace {
 
-    const auto transposed_rhs = rhs.transpose();
+/** Number of rows of A packed into the L2-resident block.  This value
+    must be a multiple of the micro-kernel tile height (4, 6, or 8). */
+constexpr size_t MC = 72;
 
-    for (size_t row = 0; (row < rows); row++) {
-        for (size_t col = 0; (col < mWidth); col++) {
-            result.data[row * mWidth + col] = 0;
-            for (size_t i = 0; (i < width); i++) {
-                result.data[row * mWidth + col] += data[row * width + i] * 
-                    transposed_rhs.data[col * width + i];
+/** Depth of the packed blocks so a B micro-panel stays in L1 */
+constexpr size_t KC = 256;
+
+/** Number of columns of B packed at a time */
+constexpr size_t NC = 1024;
+
+// Pack a mc x kc block of A into micro-panels of MR rows each.  Each
+// micro-panel is stored column-by-column (i.e., MR values for each k),
+// with rows past mc padded with zeros.
+void packA(const Val* a, const size_t rsA, const size_t csA,
+           const size_t mc, const size_t kc, const size_t MR, Val* buf) {
+    for (size_t i = 0; (i < mc); i += MR) {
+        const size_t mr = std::min(MR, mc - i);
+        for (size_t k = 0; (k < kc); k++) {
+            for (size_t r = 0; (r < MR); r++) {
+                *buf++ = (r < mr) ? a[(i + r) * rsA + k * csA] : 0;
+            }
+        }
+    }
+}
+
+// Pack a kc x nc block of B into micro-panels of NR columns each.
+// Each micro-panel is stored row-by-row (i.e., NR values for each k),
+// with columns past nc padded with zeros.
+void packB(const Val* b, const size_t rsB, const size_t csB,
+           const size_t kc, const size_t nc, const size_t NR, Val* buf) {
+    for (size_t j = 0; (j < nc); j += NR) {
+        const size_t nr = std::min(NR, nc - j);
+        for (size_t k = 0; (k < kc); k++) {
+            for (size_t c = 0; (c < NR); c++) {
+                *buf++ = (c < nr) ? b[k * rsB + (j + c) * csB] : 0;
+            }
+        }
+    }
+}
+
+// Returns a per-thread packing buffer with room for at least the
+// given number of values.  The buffers are reused across calls so
+// that steady-state matrix multiplication does not allocate memory.
+Val* packBuffer(ValVec& buf, const size_t size) {
+    if (buf.size() < size) {
+        buf.resize(size);
+    }
+    return buf.data();
+}
+
+// Computes C += A * B where A is m x k, B is k x n, and C is a
+// row-major m x n matrix with leading dimension ldc.
+void gemm(const size_t m, const size_t n, const size_t k,
+          const Val* a, const size_t rsA, const size_t csA,
+          const Val* b, const size_t rsB, const size_t csB,
+          Val* c, const size_t ldc) {
+    const MatrixKernels& kernels = matrixKernels();
+    if (n == 1 && csA == 1 && rsB == 1) {
+        // Matrix-vector product with contiguous rows of A: packing
+        // would only add overhead, so use the SIMD inner product.
+        for (size_t i = 0; (i < m); i++) {
+            c[i * ldc] += kernels.dot(a + i * rsA, b, k);
+        }
+        return;
+    }
+    if (n == 1 && rsA == 1 && ldc == 1) {
+        // Matrix-vector product with a transposed A (i.e., contiguous
+        // columns): accumulate each column scaled by b[p] into C.
+        for (size_t p = 0; (p < k); p++) {
+            kernels.axpy(b[p * rsB], a + p * csA, c, m);
+        }
+        return;
+    }
+    if (n == 1) {
+        // Matrix-vector product with a strided A.
+        for (size_t i = 0; (i < m); i++) {
+            Val sum = 0;
+            for (size_t p = 0; (p < k); p++) {
+                sum += a[i * rsA + p * csA] * b[p * rsB];
+            }
+            c[i * ldc] += sum;
+        }
+        return;
+    }
+    const size_t MR = kernels.mr, NR = kernels.nr;
+    if (m < MR || n < NR) {
+        // Too narrow to fill a register tile (for example, an outer
+        // product of two vectors). Stream rows of B instead.
+        for (size_t i = 0; (i < m); i++) {
+            for (size_t p = 0; (p < k); p++) {
+                const Val aVal = a[i * rsA + p * csA];
+                for (size_t j = 0; (j < n); j++) {
+                    c[i * ldc + j] += aVal * b[p * rsB + j * csB];
+                }
+            }
+        }
+        return;
+    }
+    thread_local ValVec bufA, bufB;
+    Val* packedA = packBuffer(bufA, MC * KC);
+    Val* packedB = packBuffer(bufB, (NC + NR) * KC);
+    for (size_t jc = 0; (jc < n); jc += NC) {
+        const size_t nc = std::min(NC, n - jc);
+        for (size_t pc = 0; (pc < k); pc += KC) {
+            const size_t kc = std::min(KC, k - pc);
+            packB(b + pc * rsB + jc * csB, rsB, csB, kc, nc, NR, packedB);
+            for (size_t ic = 0; (ic < m); ic += MC) {
+                const size_t mc = std::min(MC, m - ic);
+                packA(a + ic * rsA + pc * csA, rsA, csA, mc, kc, MR,
+                      packedA);
+                // Run the micro-kernel over each tile of this block
+                for (size_t jr = 0; (jr < nc); jr += NR) {
+                    for (size_t ir = 0; (ir < mc); ir += MR) {
+                        kernels.microKernel(kc, packedA + ir * kc,
+                                            packedB + jr * kc,
+                                            c + (ic + ir) * ldc + jc + jr,
+                                            ldc, std::min(MR, mc - ir),
+                                            std::min(NR, nc - jr));
+                    }
+                }
             }
         }
     }
+}
+
+}  // namespace
+
+Matrix Matrix::dot(const Matrix& rhs) const {
+    Matrix result;
+    dot(rhs, result);
     // Return the computed result
     return result;
 }
 
+void Matrix::dot(const Matrix& rhs, Matrix& result) const {
+    // Ensure the dimensions are compatible for matrix multiplication.
+    assert(cols == rhs.rows);
+    assert(&result != this && &result != &rhs);
+    // Setup the result matrix (initialized to zeros) and accumulate
+    // the product into it using the blocked GEMM engine above.
+    result.resize(rows, rhs.cols);
+    std::fill(result.data.begin(), result.data.end(), Val(0));
+    gemm(rows, rhs.cols, cols, data.data(), cols, 1,
+         rhs.data.data(), rhs.cols, 1, result.data.data(), rhs.cols);
+}
+
+void Matrix::dotAddBias(const Matrix& rhs, const Matrix& bias,
+                        Matrix& result) const {
+    assert(cols == rhs.rows);
+    assert(bias.rows == rows && bias.cols == 1);
+    assert(&result != this && &result != &rhs && &result != &bias);
+    // Initialize each column of the result with the biases and then
+    // accumulate the product into it.
+    result.resize(rows, rhs.cols);
+    for (size_t row = 0; (row < rows); row++) {
+        std::fill_n(result.data.begin() + row * rhs.cols, rhs.cols,
+                    bias.data[row]);
+    }
+    gemm(rows, rhs.cols, cols, data.data(), cols, 1,
+         rhs.data.data(), rhs.cols, 1, result.data.data(), rhs.cols);
+}
+
+void Matrix::dotTN(const Matrix& rhs, Matrix& result) const {
+    assert(rows == rhs.rows);
+    assert(&result != this && &result != &rhs);
+    // The transpose of this matrix is read with the strides swapped.
+    result.resize(cols, rhs.cols);
+    std::fill(result.data.begin(), result.data.end(), Val(0));
+    gemm(cols, rhs.cols, rows, data.data(), 1, cols,
+         rhs.data.data(), rhs.cols, 1, result.data.data(), rhs.cols);
+}
+
+void Matrix::dotNT(const Matrix& rhs, Matrix& result) const {
+    assert(cols == rhs.cols);
+    assert(&result != this && &result != &rhs);
+    // The transpose of rhs is read with the strides swapped.
+    result.resize(rows, rhs.rows);
+    std::fill(result.data.begin(), result.data.end(), Val(0));
+    gemm(rows, rhs.rows, cols, data.data(), cols, 1,
+         rhs.data.data(), 1, rhs.cols, result.data.data(), rhs.rows);
+}
+
+void Matrix::resize(const size_t row, const size_t col) {
+    // Note that std::vector::resize never reduces the capacity.
+    data.resize(row * col);
+    rows = row;
+    cols = col;
+}
+
+Matrix& Matrix::operator+=(const Matrix& rhs) {
+    assert(rows == rhs.rows && cols == rhs.cols);
+    matrixKernels().add(data.data(), rhs.data.data(), data.data(),
+                        data.size());
+    return *this;
+}
+
+Matrix& Matrix::operator-=(const Matrix& rhs) {
+    assert(rows == rhs.rows && cols == rhs.cols);
+    matrixKernels().sub(data.data(), rhs.data.data(), data.data(),
+                        data.size());
+    return *this;
+}
+
+Matrix& Matrix::operator*=(const Matrix& rhs) {
+    assert(rows == rhs.rows && cols == rhs.cols);
+    matrixKernels().mul(data.data(), rhs.data.data(), data.data(),
+                        data.size());
+    return *this;
+}
+
+Matrix& Matrix::operator*=(const Val val) {
+    matrixKernels().scale(data.data(), val, data.data(), data.size());
+    return *this;
+}
+
+Matrix& Matrix::addScaled(const Matrix& other, const Val alpha) {
+    assert(rows == other.rows && cols == other.cols);
+    matrixKernels().axpy(alpha, other.data.data(), data.data(), data.size());
+    return *this;
+}
+
+// The SIMD kernels used by the element-wise expressions.
+void expr::addKernel(const Val* a, const Val* b, Val* out, const size_t n) {
+    matrixKernels().add(a, b, out, n);
+}
+
+void expr::subKernel(const Val* a, const Val* b, Val* out, const size_t n) {
+    matrixKernels().sub(a, b, out, n);
+}
+
+void expr::mulKernel(const Val* a, const Val* b, Val* out, const size_t n) {
+    matrixKernels().mul(a, b, out, n);
+}
+
+void expr::scaleKernel(const Val* a, const Val s, Val* out, const size_t n) {
+    matrixKernels().scale(a, s, out, n);
+}
+
 Matrix Matrix::transpose() const {
     // If the matrix is empty, then there is nothing much to do.
     if (rows == 0 || cols == 0) {
@@ -75,7 +309,7 @@ Matrix Matrix::transpose() const {
 
     // Create a result matrix that will be the transpose, with width
     // and height flipped.
-    Matrix result(width(), height());
+    Matrix result = uninitialized(cols, rows);
     // Now copy the values creating the transpose
     for (int row = 0; (row < height()); row++) {
         for (int col = 0; (col < width()); col++) {
@@ -86,4 +320,24 @@ Matrix Matrix::transpose() const {
     return result;
 }
 
+void Matrix::sliceColumns(const size_t start, const size_t count,
+                          Matrix& result) const {
+    assert(start + count <= cols && &result != this);
+    result.resize(rows, count);
+    for (size_t row = 0; (row < rows); row++) {
+        std::copy_n(data.begin() + row * cols + start, count,
+                    result.data.begin() + row * count);
+    }
+}
+
+void Matrix::transpose(Matrix& result) const {
+    assert(&result != this);
+    result.resize(cols, rows);
+    for (size_t row = 0; (row < rows); row++) {
+        for (size_t col = 0; (col < cols); col++) {
+            result.data[col * rows + row] = data[row * cols + col];
+        }
+    }
+}
+
 #endif
@@ -12,13 +12,31 @@
 #include <functional>
 #include <vector>
 #include <cassert>
+#include <type_traits>
+#include "PoolAllocator.h"
 
-/** Shortcut for the value of each element in the matrix */
+/** Shortcut for the value of each element in the matrix.  By default
+    values are 64-bit doubles.  Compiling with -DNNET_USE_FLOAT uses
+    32-bit floats instead, which halves the memory traffic for the
+    weights and doubles the number of values in each SIMD register.
+    All the classes (and the SIMD kernels) adapt to the chosen type. */
+#ifdef NNET_USE_FLOAT
+using Val = float;
+#else
 using Val = double;
+#endif
 
-/** Short cut to a 2-d vector double values to streamline the code */
+/** Short cut to a 2-d vector of Val values to streamline the code */
 using TwoDVec = std::vector<std::vector<Val>>;
 
+/** The storage used for the values in a Matrix.  The values are
+    64-byte aligned, come from a pool of reusable blocks, and are not
+    zeroed when the vector is resized (see PoolAllocator). */
+using ValVec = std::vector<Val, PoolAllocator<Val>>;
+
+// The element-wise expressions need Val (and Matrix derives from them).
+#include "MatrixExpr.h"
+
 
 /** A matrix class to perform basic matrix operations.
 
@@ -30,12 +48,15 @@ using TwoDVec = std::vector<std::vector<Val>>;
 
     <li>Matrix multiplication using Block matrix multiplication.</li>
 
+    <li>Element-wise operators (see MatrixExpr.h) that are evaluated
+    lazily, in a single loop, when they are assigned to a matrix.</li>
+
     <li> Stream insertion and extraction operators to conveniently
     load and print values.</li>
     
     </ul>
 */
-class Matrix {
+class Matrix : public MatrixExpr<Matrix> {
     /** Stream insertion operator to ease printing matrices
      *
      * This method prints the dimension of the matrix and then prints
@@ -71,7 +92,7 @@ class Matrix {
     friend std::istream& operator>>(std::istream& is, Matrix& matrix);
 
 public:
-    std::vector<Val> data;
+    ValVec data;
     size_t rows;
     size_t cols;
 
@@ -89,6 +110,52 @@ public:
     explicit Matrix(const size_t rows = 0, const size_t cols = 0,
                     const Val initVal = 0);
 
+    /**
+     * Creates a matrix without initializing its values.  This is
+     * used for results that are fully overwritten right away, to
+     * avoid writing every value twice.
+     *
+     * \param[in] rows The number of rows to be created in the
+     * matrix.
+     *
+     * \param[in] cols The number of cols to be created in the matrix.
+     *
+     * \return A matrix with unspecified values.
+     */
+    static Matrix uninitialized(const size_t rows, const size_t cols);
+
+    /**
+     * Creates a matrix from an element-wise expression, such as a + b
+     * or m.apply(op).  The whole expression is evaluated in a single
+     * pass without creating any temporary matrices.
+     *
+     * \param[in] expr The expression to be evaluated.
+     */
+    template<typename E, typename = std::enable_if_t<
+                             !std::is_same<E, Matrix>::value>>
+    Matrix(const MatrixExpr<E>& expr) : rows(0), cols(0) {
+        *this = expr;
+    }
+
+    /**
+     * Evaluates an element-wise expression into this matrix in a
+     * single pass.  The expression may use this matrix (for example,
+     * m = m * 2 + other) as each entry only depends on the same
+     * entry of the operands.
+     *
+     * \param[in] expr The expression to be evaluated.
+     *
+     * \return A reference to this matrix.
+     */
+    template<typename E, typename = std::enable_if_t<
+                             !std::is_same<E, Matrix>::value>>
+    Matrix& operator=(const MatrixExpr<E>& expr) {
+        const E& node = expr.derived();
+        resize(node.rows, node.cols);
+        expr::evaluate(node, data.data());
+        return *this;
+    }
+
     /**
      * Returns the height or number of rows in this matrix.
      *
@@ -104,141 +171,117 @@ public:
     int width() const { return (height() > 0) ? cols : 0; }
     
     /**
-     * Creates a new matrix in which each value is obtained by
-     * applying a given unary operator to each entry in the matrix.
+     * Updates each value in this matrix by applying a given unary
+     * operator to it.  Unlike apply, this method does not allocate a
+     * new matrix.
+     *
+     * \param[in] operation The unary operation to be applied to each
+     * entry in this matrix.
      *
-     * \param[in] operation The unary operation to be used to create
-     * the given matrix.
+     * \return A reference to this matrix.
      */
     template<typename UnaryOp>
-    Matrix apply(const UnaryOp& operation) const {
-        // If the matrix is empty, then we have nothing to do.
-        if (rows == 0 || cols == 0) {
-            return *this;  // return copy of empty matrix.
+    Matrix& applyInPlace(const UnaryOp& operation) {
+        // Entries are contiguous: so a single loop suffices.
+        for (auto& val : data) {
+            val = operation(val);
         }
-        // Now apply the specified operation to each element and store it
-        // in the new matrix
-        Matrix result = *this;  // Initialize to current values.
-        // Apply unary operation to each element in the result
-        for (size_t row = 0; row < rows; row++) {
-            for (size_t col = 0; col < cols; col++) {
-                result.data[row * cols + col] = operation(
-                    result.data[row * cols + col]);
-            }
-        }
-        // The resulting matrix after applying specified operations.
-        return result;
+        return *this;
     }
 
     /**
-     * Creates a new matrix in which each value is obtained by
-     * applying a given binary operator to each entry in this matrix
-     * and another matrix.
+     * Updates each value in this matrix by applying a given binary
+     * operator to it and the corresponding value in another matrix.
+     * Unlike apply, this method does not allocate a new matrix.
      *
      * \param[in] other The other matrix to be used. Note that the
      * other matrix must be exactly the same dimension of this this.
-     * Otherwise, this method throws an exception.
      *
-     * \param[in] operation The binary operation to be used to create
-     * each value in the given matrix.
-     */    
+     * \param[in] operation The binary operation to be used to update
+     * each value in this matrix.
+     *
+     * \return A reference to this matrix.
+     */
     template<typename BinaryOp>
-    Matrix apply(const Matrix& other, const BinaryOp& operation) const {
-        // Check to ensure the number of rows are the same.
-        assert(rows == other.rows);
-        // If the matrix is empty, then we have nothing to do.
-        if (rows == 0 || cols == 0) {
-            return *this;  // return copy of empty matrix.
-        }
-        // Ensure the number of columns match.
-        assert(cols == other.cols);
-        // Now apply the specified operation to each element and store it
-        // in the new matrix
-        Matrix result = *this;  // Initialize to current values.
-        // Here we use index so that we can access the corresponding
-        // element in the other matrix as well.
-        for (size_t row = 0; (row < rows); ++row) {
-            for (size_t col = 0; (col < cols); ++col) {
-                // Recollect result is initialized to values of this
-                // matrix. So we use result to reduce the number of
-                // different values accessed.
-                result.data[row * cols + col] = operation(
-                    result.data[row * cols + col], 
-                    other.data[row * cols + col]);
-            }
+    Matrix& applyInPlace(const Matrix& other, const BinaryOp& operation) {
+        // Ensure the dimensions of the two matrices are the same.
+        assert(rows == other.rows && cols == other.cols);
+        for (size_t i = 0; (i < data.size()); i++) {
+            data[i] = operation(data[i], other.data[i]);
         }
-        // The resulting matrix after applying specified operations.
-        return result;
+        return *this;
     }
 
     /**
-     * Operator to add two matrices with the same dimensions together.
+     * Adds another matrix with the same dimensions to this matrix
+     * in place.
      *
-     * \param[in] rhs The other matrix to be used.  This matrix must
-     * have the same dimension as this matrix.  Otherwise this method
-     * throws an excpetion.
+     * \param[in] rhs The other matrix to be added.
      *
-     * \return The resulting matrix in which each value has been
-     * computed by adding the corresponding values from \c this and
-     * rhs.
+     * \return A reference to this matrix.
      */
-    Matrix operator+(const Matrix& rhs) const {
-        return apply(rhs, [](const auto& v1, const auto& v2) {
-                              return v1 + v2; });
-    }
+    Matrix& operator+=(const Matrix& rhs);
 
     /**
-     * Operator for computing the Hadamard product of two matrices
-     * with the same dimensions.
+     * Subtracts another matrix with the same dimensions from this
+     * matrix in place.
      *
-     * \param[in] rhs The other matrix to be used.  This matrix must
-     * have the same dimension as this matrix.  Otherwise this method
-     * throws an excpetion.
+     * \param[in] rhs The other matrix to be subtracted.
      *
-     * \return The resulting matrix in which each value has been
-     * computed by multiplying the corresponding values from \c this
-     * and rhs.
+     * \return A reference to this matrix.
      */
-    Matrix operator*(const Matrix& rhs) const {
-        return apply(rhs, [](const auto& v1, const auto& v2) {
-                              return v1 * v2; });
-    }
+    Matrix& operator-=(const Matrix& rhs);
 
     /**
-     * Operator for computing the Hadamard product of two matrices
-     * with the same dimensions.
+     * Updates this matrix to the Hadamard product of this matrix and
+     * another matrix with the same dimensions.
      *
-     * \param[in] rhs The other matrix to be used.  This matrix must
-     * have the same dimension as this matrix.  Otherwise this method
-     * throws an excpetion.
+     * \param[in] rhs The other matrix to be multiplied.
      *
-     * \return The resulting matrix in which each value has been
-     * computed by multiplying the corresponding values from \c this
-     * and rhs.
+     * \return A reference to this matrix.
      */
-    Matrix operator*(const Val val) const {
-        return apply([val](const auto& v) { return v * val; });
-    }
-    
+    Matrix& operator*=(const Matrix& rhs);
+
     /**
-     * Operator to subtract two matrices with the same dimensions.
+     * Multiplies each value in this matrix by a given value in place.
      *
-     * \param[in] rhs The other matrix to be used.  This matrix must
-     * have the same dimension as this matrix.  Otherwise this method
-     * throws an excpetion.
+     * \param[in] val The value by which each entry is multiplied.
      *
-     * \return The resulting matrix in which each value has been
-     * computed by subtracting the corresponding values from \c this
-     * and rhs.
+     * \return A reference to this matrix.
      */
-    Matrix operator-(const Matrix& rhs) const {
-        return apply(rhs, [](const auto& v1, const auto& v2)  {
-                              return v1 - v2; });
-    }
-    
+    Matrix& operator*=(const Val val);
+
+    /**
+     * Adds a scaled version of another matrix to this matrix (i.e.,
+     * this = this + alpha * other) in one pass without creating any
+     * temporary matrices.  For example, a gradient descent step can
+     * be written as weights.addScaled(nabla_w, -eta).
+     *
+     * \param[in] other The other matrix with the same dimensions.
+     *
+     * \param[in] alpha The factor by which values in other are scaled.
+     *
+     * \return A reference to this matrix.
+     */
+    Matrix& addScaled(const Matrix& other, const Val alpha);
+
+    /**
+     * Changes the dimensions of this matrix.  The underlying storage
+     * is reused whenever it is large enough, so a matrix that is
+     * repeatedly resized to the same (or smaller) dimensions does not
+     * allocate memory.  The values in the matrix are unspecified
+     * after this call.
+     *
+     * \param[in] rows The new number of rows.
+     *
+     * \param[in] cols The new number of columns.
+     */
+    void resize(const size_t rows, const size_t cols);
+
     /**
      * Performs the dot product of two matrices. This method has a
-     * O(n^3) time complexity.
+     * O(n^3) time complexity.  Larger products are computed using
+     * cache-blocked, packed panels and a register-tiled micro-kernel.
      *
      * \param[in] rhs The other matrix to be used.  This matrix must
      * have the same number of rows as the number of columns in this
@@ -250,10 +293,97 @@ public:
      */
     Matrix dot(const Matrix& rhs) const;
 
+    /**
+     * Performs the dot product of two matrices, storing the result in
+     * a caller-provided matrix to avoid allocating memory.
+     *
+     * \param[in] rhs The other matrix to be used.  This matrix must
+     * have the same number of rows as the number of columns in this
+     * matrix.
+     *
+     * \param[out] result The matrix to be resized (if needed) and
+     * set to the product of \c this and rhs.  This matrix must not be
+     * the same as \c this or rhs.
+     */
+    void dot(const Matrix& rhs, Matrix& result) const;
+
+    /**
+     * Fused form of dot(rhs) + bias, where the column-vector bias is
+     * added to each column of the product.  The bias is used to
+     * initialize the result so that it is added for free by the
+     * matrix multiplication.
+     *
+     * \param[in] rhs The other matrix to be used.  This matrix must
+     * have the same number of rows as the number of columns in this
+     * matrix.
+     *
+     * \param[in] bias A column-vector with the same number of rows as
+     * this matrix.
+     *
+     * \param[out] result The matrix to be resized (if needed) and
+     * set to the product of \c this and rhs plus bias.
+     */
+    void dotAddBias(const Matrix& rhs, const Matrix& bias,
+                    Matrix& result) const;
+
+    /**
+     * Computes transpose(this) . rhs without creating the transpose.
+     * The transposed operand is read in place by the matrix
+     * multiplication.  For example, backpropagation uses this method
+     * to compute transpose(weights) . delta.
+     *
+     * \param[in] rhs The other matrix to be used.  This matrix must
+     * have the same number of rows as this matrix.
+     *
+     * \param[out] result The matrix to be resized (if needed) to cols
+     * x rhs.cols and set to the product.  This matrix must not be the
+     * same as \c this or rhs.
+     */
+    void dotTN(const Matrix& rhs, Matrix& result) const;
+
+    /**
+     * Computes this . transpose(rhs) without creating the transpose.
+     * For example, backpropagation uses this method to compute the
+     * weight gradients delta . transpose(activations).
+     *
+     * \param[in] rhs The other matrix to be used.  This matrix must
+     * have the same number of columns as this matrix.
+     *
+     * \param[out] result The matrix to be resized (if needed) to rows
+     * x rhs.rows and set to the product.  This matrix must not be the
+     * same as \c this or rhs.
+     */
+    void dotNT(const Matrix& rhs, Matrix& result) const;
+
     /**
      * Returns the transpose of this matrix.
      */
     Matrix transpose() const;
+
+    /**
+     * Stores the transpose of this matrix in a caller-provided matrix
+     * to avoid allocating memory.
+     *
+     * \param[out] result The matrix to be resized (if needed) and set
+     * to the transpose of this matrix.  This matrix must not be the
+     * same as \c this.
+     */
+    void transpose(Matrix& result) const;
+
+    /**
+     * Copies a contiguous range of columns from this matrix into a
+     * caller-provided matrix.  This is used to split a batch (with
+     * one image per column) into smaller batches.
+     *
+     * \param[in] start The index of the first column to be copied.
+     *
+     * \param[in] count The number of columns to be copied.
+     *
+     * \param[out] result The matrix to be resized (if needed) to
+     * rows x count and set to the copied columns.
+     */
+    void sliceColumns(const size_t start, const size_t count,
+                      Matrix& result) const;
 };
 
 
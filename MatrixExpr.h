@@ -0,0 +1,299 @@
+#ifndef MATRIX_EXPR_H
+#define MATRIX_EXPR_H
+
+/** \file MatrixExpr.h Lazily evaluated element-wise Matrix expressions.
+
+    This file contains the expression templates used by the
+    element-wise operators (+, -, Hadamard *, and scaling) and the
+    apply methods of Matrix.  Rather than computing a new matrix, each
+    operator returns a small object that records the operation and its
+    operands.  The whole expression is then evaluated in a single loop
+    (without any temporary matrices) when it is assigned to a Matrix.
+    For example:
+
+    \code
+    Matrix delta = (out - expected) * out.apply(sigmoidPrime);
+    \endcode
+
+    reads out and expected once and writes delta once, whereas eager
+    evaluation would create three temporaries and make four passes.
+
+    The expressions refer to (rather than copy) the matrices used in
+    them.  So an expression must be assigned to a Matrix in the same
+    statement in which it is created.  In particular, do not store an
+    expression in an auto variable.
+
+    This file is included by Matrix.h and should not be included
+    directly.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+class Matrix;
+
+/**
+ * The base class of all the element-wise expressions (including
+ * Matrix itself).  This class uses the curiously recurring template
+ * pattern so that the operators are resolved at compile time and the
+ * evaluation loop is fully inlined.
+ *
+ * \tparam Derived The class of the expression.
+ */
+template<typename Derived>
+class MatrixExpr {
+public:
+    /** Returns this expression as its actual class */
+    const Derived& derived() const {
+        return static_cast<const Derived&>(*this);
+    }
+
+    /**
+     * Returns an expression in which each value is obtained by
+     * applying a given unary operator to each entry of this one.
+     *
+     * \param[in] operation The unary operation to be applied.
+     */
+    template<typename UnaryOp>
+    auto apply(const UnaryOp& operation) const;
+
+    /**
+     * Returns an expression in which each value is obtained by
+     * applying a given binary operator to each entry of this one and
+     * of another expression.
+     *
+     * \param[in] other The other expression. It must have exactly the
+     * same dimensions as this one.
+     *
+     * \param[in] operation The binary operation to be applied.
+     */
+    template<typename Other, typename BinaryOp>
+    auto apply(const MatrixExpr<Other>& other,
+               const BinaryOp& operation) const;
+};
+
+/** The classes used to build and evaluate the expressions */
+namespace expr {
+
+/** The signature of the SIMD kernels for element-wise operations */
+using BinaryKernel = void (*)(const Val* a, const Val* b, Val* out,
+                              const size_t n);
+
+// The SIMD kernels used for expressions that are a single operation
+// on two matrices (defined in Matrix.cpp, as the kernel table needs
+// the complete Matrix class).
+void addKernel(const Val* a, const Val* b, Val* out, const size_t n);
+void subKernel(const Val* a, const Val* b, Val* out, const size_t n);
+void mulKernel(const Val* a, const Val* b, Val* out, const size_t n);
+void scaleKernel(const Val* a, const Val s, Val* out, const size_t n);
+
+/** The values of a Matrix used in an expression */
+struct Leaf {
+    const Val* vals;
+    size_t rows;
+    size_t cols;
+
+    Val operator[](const size_t i) const { return vals[i]; }
+};
+
+/** An operation on each entry of an expression */
+template<typename Arg, typename Op>
+struct Unary : public MatrixExpr<Unary<Arg, Op>> {
+    Arg arg;
+    Op op;
+    size_t rows;
+    size_t cols;
+
+    Unary(const Arg& arg, const Op& op) :
+        arg(arg), op(op), rows(arg.rows), cols(arg.cols) {}
+
+    Val operator[](const size_t i) const { return op(arg[i]); }
+};
+
+/** An operation on the corresponding entries of two expressions */
+template<typename Lhs, typename Rhs, typename Op>
+struct Binary : public MatrixExpr<Binary<Lhs, Rhs, Op>> {
+    Lhs lhs;
+    Rhs rhs;
+    Op op;
+    size_t rows;
+    size_t cols;
+
+    Binary(const Lhs& lhs, const Rhs& rhs, const Op& op) :
+        lhs(lhs), rhs(rhs), op(op), rows(lhs.rows), cols(lhs.cols) {
+        // Ensure the dimensions of the two operands are the same.
+        assert(lhs.rows == rhs.rows && lhs.cols == rhs.cols);
+    }
+
+    Val operator[](const size_t i) const { return op(lhs[i], rhs[i]); }
+};
+
+/** The operations used by the operators */
+struct Add {
+    Val operator()(const Val a, const Val b) const { return a + b; }
+    static constexpr BinaryKernel kernel = addKernel;
+};
+
+struct Sub {
+    Val operator()(const Val a, const Val b) const { return a - b; }
+    static constexpr BinaryKernel kernel = subKernel;
+};
+
+struct Mul {
+    Val operator()(const Val a, const Val b) const { return a * b; }
+    static constexpr BinaryKernel kernel = mulKernel;
+};
+
+struct Scale {
+    Val factor;
+    Val operator()(const Val a) const { return a * factor; }
+};
+
+/**
+ * Converts an expression into the object stored in a larger
+ * expression: matrices are referred to via a Leaf and the other
+ * expressions (which hold only references and operators) are copied.
+ */
+template<typename E>
+struct Operand {
+    using type = E;
+    static const E& wrap(const E& expr) { return expr; }
+};
+
+template<>
+struct Operand<Matrix> {
+    using type = Leaf;
+    template<typename M>
+    static Leaf wrap(const M& mat) {
+        return {mat.data.data(), mat.rows, mat.cols};
+    }
+};
+
+/** Shortcut to the type stored for an expression */
+template<typename E>
+using OperandT = typename Operand<E>::type;
+
+/** Returns the object stored for an expression */
+template<typename E>
+OperandT<E> operand(const MatrixExpr<E>& expr) {
+    return Operand<E>::wrap(expr.derived());
+}
+
+/**
+ * Evaluates an expression into an array in a single loop.  The
+ * entries of an expression depend only on the same entries of its
+ * operands, so the array may be one of the operands (for example,
+ * in a = a + b).
+ *
+ * \param[in] expr The expression to be evaluated.
+ *
+ * \param[out] out The array for the rows * cols values.
+ */
+template<typename E>
+void evaluate(const E& expr, Val* out) {
+    const size_t n = expr.rows * expr.cols;
+    for (size_t i = 0; (i < n); i++) {
+        out[i] = expr[i];
+    }
+}
+
+// A single operator on two matrices uses the SIMD kernels.
+template<typename Op, typename = decltype(Op::kernel)>
+void evaluate(const Binary<Leaf, Leaf, Op>& expr, Val* out) {
+    Op::kernel(expr.lhs.vals, expr.rhs.vals, out, expr.rows * expr.cols);
+}
+
+// Scaling a matrix uses the SIMD kernel.
+inline void evaluate(const Unary<Leaf, Scale>& expr, Val* out) {
+    scaleKernel(expr.arg.vals, expr.op.factor, out, expr.rows * expr.cols);
+}
+
+}  // namespace expr
+
+template<typename Derived>
+template<typename UnaryOp>
+auto MatrixExpr<Derived>::apply(const UnaryOp& operation) const {
+    return expr::Unary<expr::OperandT<Derived>, UnaryOp>(
+        expr::operand(*this), operation);
+}
+
+template<typename Derived>
+template<typename Other, typename BinaryOp>
+auto MatrixExpr<Derived>::apply(const MatrixExpr<Other>& other,
+                                const BinaryOp& operation) const {
+    return expr::Binary<expr::OperandT<Derived>, expr::OperandT<Other>,
+                        BinaryOp>(expr::operand(*this),
+                                  expr::operand(other), operation);
+}
+
+/**
+ * Operator to add two matrices (or expressions) with the same
+ * dimensions together.
+ *
+ * \param[in] lhs The first matrix to be used.
+ *
+ * \param[in] rhs The other matrix to be used.  This matrix must
+ * have the same dimension as lhs.
+ *
+ * \return An expression in which each value is the sum of the
+ * corresponding values from lhs and rhs.
+ */
+template<typename L, typename R>
+auto operator+(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    return lhs.apply(rhs, expr::Add());
+}
+
+/**
+ * Operator to subtract two matrices (or expressions) with the same
+ * dimensions.
+ *
+ * \param[in] lhs The first matrix to be used.
+ *
+ * \param[in] rhs The other matrix to be used.  This matrix must
+ * have the same dimension as lhs.
+ *
+ * \return An expression in which each value is obtained by
+ * subtracting the corresponding value in rhs from the one in lhs.
+ */
+template<typename L, typename R>
+auto operator-(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    return lhs.apply(rhs, expr::Sub());
+}
+
+/**
+ * Operator for computing the Hadamard product of two matrices (or
+ * expressions) with the same dimensions.
+ *
+ * \param[in] lhs The first matrix to be used.
+ *
+ * \param[in] rhs The other matrix to be used.  This matrix must
+ * have the same dimension as lhs.
+ *
+ * \return An expression in which each value is the product of the
+ * corresponding values from lhs and rhs.
+ */
+template<typename L, typename R>
+auto operator*(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    return lhs.apply(rhs, expr::Mul());
+}
+
+/**
+ * Operator for multiplying each value in a matrix (or expression) by
+ * a given value.
+ *
+ * \param[in] lhs The matrix to be used.
+ *
+ * \param[in] val The value by which each entry is multiplied.
+ *
+ * \return An expression in which each value is the corresponding
+ * value from lhs multiplied by val.
+ */
+template<typename E>
+auto operator*(const MatrixExpr<E>& lhs, const Val val) {
+    return lhs.apply(expr::Scale{val});
+}
+
+#endif
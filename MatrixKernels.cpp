@@ -0,0 +1,149 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef MATRIX_KERNELS_CPP
+#define MATRIX_KERNELS_CPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include "MatrixKernels.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Compile the kernels once for each instruction set of interest.  The
+// baseline version (SSE2 on x86-64 and NEON on 64-bit ARM) needs no
+// special target as it is part of the respective base architecture.
+#define KERNEL_NS   baseline
+#define KERNEL_VEC_BYTES 16
+#define KERNEL_MR   4
+#define KERNEL_NR_VECS 2
+#if defined(__aarch64__)
+#define KERNEL_NAME "neon"
+#else
+#define KERNEL_NAME "sse2"
+#endif
+#include "MatrixKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_VEC_BYTES
+#undef KERNEL_MR
+#undef KERNEL_NR_VECS
+
+#if defined(__x86_64__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define KERNEL_NS   avx2
+#define KERNEL_NAME "avx2"
+#define KERNEL_VEC_BYTES 32
+#define KERNEL_MR   6
+#define KERNEL_NR_VECS 2
+#include "MatrixKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_VEC_BYTES
+#undef KERNEL_MR
+#undef KERNEL_NR_VECS
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#define KERNEL_NS   avx512
+#define KERNEL_NAME "avx512"
+#define KERNEL_VEC_BYTES 64
+#define KERNEL_MR   8
+#define KERNEL_NR_VECS 2
+#include "MatrixKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#undef KERNEL_VEC_BYTES
+#undef KERNEL_MR
+#undef KERNEL_NR_VECS
+#pragma GCC pop_options
+
+// The int8 inner product using the AVX-512 VNNI instruction (vpdpbusd)
+// that multiplies 64 pairs of unsigned and signed bytes and adds
+// groups of 4 products into 16 32-bit sums in a single instruction.
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512vnni")
+static int32_t dotU8S8Vnni(const uint8_t* a, const int8_t* b,
+                           const size_t n) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; (i + 64 <= n); i += 64) {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + i),
+                                  _mm512_loadu_si512(b + i));
+    }
+    if (i < n) {
+        // Masked loads read zeros past the end of the arrays.
+        const __mmask64 mask = (~0ULL) >> (64 - (n - i));
+        acc = _mm512_dpbusd_epi32(acc, _mm512_maskz_loadu_epi8(mask, a + i),
+                                  _mm512_maskz_loadu_epi8(mask, b + i));
+    }
+    alignas(64) int32_t sums[16];
+    _mm512_store_si512(sums, acc);
+    int32_t sum = 0;
+    for (const int32_t val : sums) {
+        sum += val;
+    }
+    return sum;
+}
+#pragma GCC pop_options
+
+// The AVX-512 kernels with the int8 inner product replaced by VNNI.
+static const MatrixKernels avx512vnniTable = [] {
+    MatrixKernels kernels = avx512::table;
+    kernels.name    = "avx512vnni";
+    kernels.dotU8S8 = dotU8S8Vnni;
+    return kernels;
+}();
+#endif
+
+// Helper method to choose the kernels to be used on this CPU.
+static const MatrixKernels& selectKernels() {
+    // An optional upper limit on the instruction set to be used.
+    // Unknown names are ignored, so that a typo does not quietly
+    // lower the choice to the baseline kernels.
+    const char* limit = std::getenv("NNET_SIMD");
+    const std::array<const char*, 5> names = {"sse2", "avx2", "avx512",
+                                              "avx512vnni", "neon"};
+    if (limit != nullptr &&
+        std::none_of(names.begin(), names.end(), [limit](const char* name) {
+            return std::strcmp(limit, name) == 0; })) {
+        std::cerr << "Ignoring unknown NNET_SIMD value: " << limit << '\n';
+        limit = nullptr;
+    }
+    const auto allowed = [limit](const char* name) {
+        return (limit == nullptr) || (std::strcmp(limit, name) == 0);
+    };
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (allowed("avx512vnni") && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vnni")) {
+        return avx512vnniTable;
+    }
+    if ((allowed("avx512vnni") || allowed("avx512")) &&
+        __builtin_cpu_supports("avx512f")) {
+        return avx512::table;
+    }
+    if ((allowed("avx512vnni") || allowed("avx512") || allowed("avx2")) &&
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2::table;
+    }
+#endif
+    return baseline::table;
+}
+
+const MatrixKernels& matrixKernels() {
+    static const MatrixKernels& kernels = selectKernels();
+    return kernels;
+}
+
+#endif
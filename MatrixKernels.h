@@ -0,0 +1,97 @@
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+/** \file MatrixKernels.h Hand-vectorized kernels used by Matrix.
+
+    This file declares a table of SIMD kernels for the hot loops in the
+    Matrix class (inner products, element-wise operations, sigmoid, and
+    the GEMM micro-kernel) and the int8 inner product used by
+    QuantizedNet.  The kernels are compiled several times for
+    different instruction sets (SSE2, AVX2+FMA, AVX-512 on x86 and NEON
+    on ARM) and the best version supported by the CPU is selected once
+    at startup.  Consequently, a single portable binary (compiled
+    without -march=native) runs the widest kernels on every node.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include "Matrix.h"
+
+/**
+ * The table of kernels for one instruction set.  All pointers use
+ * unaligned loads and stores, so callers do not need to align data.
+ * The output of the element-wise kernels may be the same as one of
+ * the inputs so that they can also be used for in-place updates.
+ */
+struct MatrixKernels {
+    /** Name of the instruction set used (for example, "avx2") */
+    const char* name;
+
+    /** Number of rows of the result tile computed by microKernel */
+    size_t mr;
+
+    /** Number of columns of the result tile computed by microKernel */
+    size_t nr;
+
+    /** Returns the inner product of two vectors with n values */
+    Val (*dot)(const Val* a, const Val* b, size_t n);
+
+    /** Computes out[i] = a[i] + b[i] for n values */
+    void (*add)(const Val* a, const Val* b, Val* out, size_t n);
+
+    /** Computes out[i] = a[i] - b[i] for n values */
+    void (*sub)(const Val* a, const Val* b, Val* out, size_t n);
+
+    /** Computes out[i] = a[i] * b[i] for n values */
+    void (*mul)(const Val* a, const Val* b, Val* out, size_t n);
+
+    /** Computes out[i] = a[i] * s for n values */
+    void (*scale)(const Val* a, Val s, Val* out, size_t n);
+
+    /** Computes y[i] += alpha * x[i] for n values */
+    void (*axpy)(Val alpha, const Val* x, Val* y, size_t n);
+
+    /** Computes out[i] = 1 / (1 + exp(-in[i])) for n values */
+    void (*sigmoid)(const Val* in, Val* out, size_t n);
+
+    /**
+     * Computes delta[i] *= act[i] * (1 - act[i]) for n values.  This
+     * is the derivative of the sigmoid obtained from the activations
+     * (act = sigmoid(z)) without recomputing any exponentials.
+     */
+    void (*sigmoidGrad)(const Val* act, Val* delta, size_t n);
+
+    /**
+     * Accumulates the product of a packed this->mr x kc micro-panel
+     * of A and a packed kc x this->nr micro-panel of B into the
+     * top-left mr x nr values of a tile of C with leading dimension
+     * ldc.  The tile sizes differ between instruction sets so that
+     * the accumulators fill (but do not spill) the vector registers.
+     */
+    void (*microKernel)(size_t kc, const Val* a, const Val* b, Val* c,
+                        size_t ldc, size_t mr, size_t nr);
+
+    /**
+     * Returns the exact integer inner product of n unsigned bytes in
+     * a and n signed bytes in b.  This is the core of the quantized
+     * (int8) inference in QuantizedNet and uses the VNNI dot-product
+     * instructions where available.
+     */
+    int32_t (*dotU8S8)(const uint8_t* a, const int8_t* b, size_t n);
+};
+
+/**
+ * Returns the kernels for the widest instruction set supported by
+ * this CPU.  The choice is made on the first call and can be lowered
+ * (but not raised) by setting the NNET_SIMD environment variable to
+ * "sse2", "avx2", "avx512", "avx512vnni" or "neon", which is handy to
+ * compare instruction sets on the same node.  Other values are ignored
+ * (with a warning on stderr).
+ *
+ * \return The kernel table to be used for all matrix operations.
+ */
+const MatrixKernels& matrixKernels();
+
+#endif
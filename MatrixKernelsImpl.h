@@ -0,0 +1,266 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+/** \file MatrixKernelsImpl.h The bodies of the SIMD kernels.
+
+    This file is intentionally NOT guarded against multiple inclusion.
+    MatrixKernels.cpp includes it once per instruction set, each time
+    with a different "#pragma GCC target" in effect and with the
+    following macros defined:
+
+    <ul>
+    <li>KERNEL_NS: The namespace in which the kernels are placed.</li>
+    <li>KERNEL_NAME: The name of the instruction set as a string.</li>
+    <li>KERNEL_VEC_BYTES: The width of a SIMD register in bytes.</li>
+    <li>KERNEL_MR: The number of rows in the GEMM micro-kernel tile.</li>
+    <li>KERNEL_NR_VECS: The number of vectors in each row of the GEMM
+    micro-kernel tile.</li>
+    </ul>
+
+    The kernels are written using GCC vector extensions so that the
+    same source is compiled into SSE2, AVX2, AVX-512, or NEON code
+    depending on the target in effect.
+*/
+
+namespace KERNEL_NS {
+
+/** A SIMD register of Val values that may be loaded unaligned */
+typedef Val Vec __attribute__((vector_size(KERNEL_VEC_BYTES),
+                               __may_alias__, __aligned__(alignof(Val))));
+
+/** Integer type with the same size as Val used for exponent tricks */
+using IVal = std::conditional_t<sizeof(Val) == 8, int64_t, int32_t>;
+
+/** A SIMD register of integers with the same layout as Vec */
+typedef IVal IVec __attribute__((vector_size(KERNEL_VEC_BYTES)));
+
+/** Number of Val values in a Vec */
+constexpr size_t Lanes = KERNEL_VEC_BYTES / sizeof(Val);
+
+/** Number of rows in the tile computed by the GEMM micro-kernel */
+constexpr size_t TileMR = KERNEL_MR;
+
+/** Number of vectors in each row of the GEMM micro-kernel tile */
+constexpr size_t TileNRVecs = KERNEL_NR_VECS;
+
+/** Number of columns in the tile computed by the GEMM micro-kernel */
+constexpr size_t TileNR = TileNRVecs * Lanes;
+
+inline Vec load(const Val* p) { return *reinterpret_cast<const Vec*>(p); }
+
+inline void store(Val* p, const Vec v) { *reinterpret_cast<Vec*>(p) = v; }
+
+// Returns a vector with all lanes set to the given value.
+inline Vec splat(const Val v) {
+    Vec vec;
+    for (size_t i = 0; (i < Lanes); i++) {
+        vec[i] = v;
+    }
+    return vec;
+}
+
+// Returns the sum of all the lanes in a vector.
+inline Val hsum(const Vec v) {
+    Val sum = 0;
+    for (size_t i = 0; (i < Lanes); i++) {
+        sum += v[i];
+    }
+    return sum;
+}
+
+Val dot(const Val* a, const Val* b, const size_t n) {
+    // Use 4 independent accumulators to hide the latency of the adds.
+    Vec acc0{}, acc1{}, acc2{}, acc3{};
+    size_t i = 0;
+    for (; (i + 4 * Lanes <= n); i += 4 * Lanes) {
+        acc0 += load(a + i) * load(b + i);
+        acc1 += load(a + i + Lanes) * load(b + i + Lanes);
+        acc2 += load(a + i + 2 * Lanes) * load(b + i + 2 * Lanes);
+        acc3 += load(a + i + 3 * Lanes) * load(b + i + 3 * Lanes);
+    }
+    for (; (i + Lanes <= n); i += Lanes) {
+        acc0 += load(a + i) * load(b + i);
+    }
+    Val sum = hsum((acc0 + acc1) + (acc2 + acc3));
+    for (; (i < n); i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Helper macro to define the element-wise binary kernels that differ
+// only in the operator used.
+#define KERNEL_BINARY_OP(fnName, op)                                    \
+    void fnName(const Val* a, const Val* b, Val* out, const size_t n) { \
+        size_t i = 0;                                                   \
+        for (; (i + Lanes <= n); i += Lanes) {                          \
+            store(out + i, load(a + i) op load(b + i));                 \
+        }                                                               \
+        for (; (i < n); i++) {                                          \
+            out[i] = a[i] op b[i];                                      \
+        }                                                               \
+    }
+
+KERNEL_BINARY_OP(add, +)
+KERNEL_BINARY_OP(sub, -)
+KERNEL_BINARY_OP(mul, *)
+
+#undef KERNEL_BINARY_OP
+
+void scale(const Val* a, const Val s, Val* out, const size_t n) {
+    const Vec sv = splat(s);
+    size_t i = 0;
+    for (; (i + Lanes <= n); i += Lanes) {
+        store(out + i, load(a + i) * sv);
+    }
+    for (; (i < n); i++) {
+        out[i] = a[i] * s;
+    }
+}
+
+void axpy(const Val alpha, const Val* x, Val* y, const size_t n) {
+    const Vec av = splat(alpha);
+    size_t i = 0;
+    for (; (i + Lanes <= n); i += Lanes) {
+        store(y + i, load(y + i) + av * load(x + i));
+    }
+    for (; (i < n); i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// Vectorized exp(x).  The argument is reduced to x = n * ln(2) + r
+// with |r| <= ln(2)/2, e^r is computed via a polynomial, and 2^n is
+// constructed directly in the exponent bits of the result.  The
+// polynomial degree is chosen so that the result is accurate to
+// within a couple of ulps for both double and float.
+inline Vec exp(Vec x) {
+    constexpr bool isDouble = (sizeof(Val) == 8);
+    constexpr Val maxArg  = isDouble ? 708.0 : 87.0;
+    constexpr Val log2e   = 1.4426950408889634;
+    constexpr Val ln2Hi   = isDouble ? 6.93145751953125e-1 : 0.693359375;
+    constexpr Val ln2Lo   = isDouble ? 1.42860682030941723212e-6
+                                     : -2.12194440e-4;
+    // Adding and subtracting this value rounds to the nearest integer
+    // and leaves the integer in the low bits of the mantissa.
+    constexpr Val magic   = isDouble ? 6755399441055744.0 : 12582912.0;
+    constexpr int mantBits = isDouble ? 52 : 23;
+    constexpr IVal bias   = isDouble ? 1023 : 127;
+    constexpr int degree  = isDouble ? 13 : 7;
+
+    x = (x > maxArg) ? splat(maxArg) : x;
+    x = (x < -maxArg) ? splat(-maxArg) : x;
+    const Vec magicV = splat(magic);
+    const Vec t = x * log2e + magicV;
+    const Vec n = t - magicV;
+    const Vec r = (x - n * ln2Hi) - n * ln2Lo;
+    // Evaluate the Taylor polynomial of e^r using Horner's rule.
+    Vec p = splat(1);
+    for (int i = degree; (i > 0); i--) {
+        p = p * r * (Val(1) / i) + 1;
+    }
+    // Build 2^n from the integer in the low bits of t.
+    // Note that casts between vector types reinterpret the bits.
+    const IVec ni = (IVec)t - (IVec)magicV;
+    const IVec bits = (ni + bias) << mantBits;
+    return p * (Vec)bits;
+}
+
+void sigmoid(const Val* in, Val* out, const size_t n) {
+    const Vec one = splat(1);
+    size_t i = 0;
+    for (; (i + Lanes <= n); i += Lanes) {
+        store(out + i, one / (one + exp(-load(in + i))));
+    }
+    for (; (i < n); i++) {
+        out[i] = 1. / (1. + std::exp(-in[i]));
+    }
+}
+
+void sigmoidGrad(const Val* act, Val* delta, const size_t n) {
+    const Vec one = splat(1);
+    size_t i = 0;
+    for (; (i + Lanes <= n); i += Lanes) {
+        const Vec a = load(act + i);
+        store(delta + i, load(delta + i) * (a * (one - a)));
+    }
+    for (; (i < n); i++) {
+        delta[i] *= act[i] * (1 - act[i]);
+    }
+}
+
+void microKernel(const size_t kc, const Val* a, const Val* b, Val* c,
+                 const size_t ldc, const size_t mr, const size_t nr) {
+    // The accumulators for the TileMR x TileNR tile held in registers.
+    Vec acc[TileMR][TileNRVecs] = {};
+    for (size_t k = 0; (k < kc); k++, a += TileMR, b += TileNR) {
+        Vec bv[TileNRVecs];
+        for (size_t v = 0; (v < TileNRVecs); v++) {
+            bv[v] = load(b + v * Lanes);
+        }
+        for (size_t r = 0; (r < TileMR); r++) {
+            const Vec av = splat(a[r]);
+            for (size_t v = 0; (v < TileNRVecs); v++) {
+                acc[r][v] += av * bv[v];
+            }
+        }
+    }
+    // Add the tile to C, handling partial tiles at the matrix edges.
+    if (mr == TileMR && nr == TileNR) {
+        for (size_t r = 0; (r < TileMR); r++) {
+            for (size_t v = 0; (v < TileNRVecs); v++) {
+                Val* dest = c + r * ldc + v * Lanes;
+                store(dest, load(dest) + acc[r][v]);
+            }
+        }
+        return;
+    }
+    for (size_t r = 0; (r < mr); r++) {
+        for (size_t col = 0; (col < nr); col++) {
+            c[r * ldc + col] += acc[r][col / Lanes][col % Lanes];
+        }
+    }
+}
+
+/** A SIMD register of unsigned bytes that may be loaded unaligned */
+typedef uint8_t U8Vec __attribute__((vector_size(KERNEL_VEC_BYTES),
+                                     __may_alias__, __aligned__(1)));
+
+/** A SIMD register of signed bytes that may be loaded unaligned */
+typedef int8_t S8Vec __attribute__((vector_size(KERNEL_VEC_BYTES),
+                                    __may_alias__, __aligned__(1)));
+
+/** The bytes in a U8Vec or S8Vec widened to 16-bit integers */
+typedef int16_t I16Vec __attribute__((vector_size(2 * KERNEL_VEC_BYTES)));
+
+/** The bytes in a U8Vec or S8Vec widened to 32-bit integers */
+typedef int32_t I32Vec __attribute__((vector_size(4 * KERNEL_VEC_BYTES)));
+
+int32_t dotU8S8(const uint8_t* a, const int8_t* b, const size_t n) {
+    // The product of an unsigned and a signed byte always fits in 16
+    // bits.  So multiply as 16-bit values and accumulate in 32 bits.
+    I32Vec acc{};
+    size_t i = 0;
+    for (; (i + KERNEL_VEC_BYTES <= n); i += KERNEL_VEC_BYTES) {
+        const I16Vec prod =
+            __builtin_convertvector(*reinterpret_cast<const U8Vec*>(a + i),
+                                    I16Vec) *
+            __builtin_convertvector(*reinterpret_cast<const S8Vec*>(b + i),
+                                    I16Vec);
+        acc += __builtin_convertvector(prod, I32Vec);
+    }
+    int32_t sum = 0;
+    for (size_t j = 0; (j < KERNEL_VEC_BYTES); j++) {
+        sum += acc[j];
+    }
+    for (; (i < n); i++) {
+        sum += int32_t(a[i]) * b[i];
+    }
+    return sum;
+}
+
+/** The table of kernels for this instruction set */
+const MatrixKernels table = {KERNEL_NAME, TileMR, TileNR, dot, add, sub,
+                             mul, scale, axpy, sigmoid, sigmoidGrad,
+                             microKernel, dotU8S8};
+
+}  // namespace KERNEL_NS
@@ -17,18 +17,67 @@
 #include <random>
 #include <cmath>
 #include <algorithm>
+#include <numeric>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "NeuralNet.h"
+#include "MatrixKernels.h"
+#include "Profiler.h"
 
 // The constructor to create a neural network with a given number of
 // layers, with each layer having a given number of neurons.
-NeuralNet::NeuralNet(const std::vector<int>& layers) :
-    layerSizes(1, layers.size()) {
+NeuralNet::NeuralNet(const std::vector<int>& layers,
+                     const std::vector<Activation>& activations,
+                     const Loss loss) :
+    layerSizes(1, layers.size()), layerActivations(activations), loss(loss) {
     // Copy the values into the layer size matrix
     std::copy_n(layers.begin(), layers.size(), layerSizes.data.begin());
+    // Check the activation functions for the layers.
+    const size_t lyrCount = layers.empty() ? 0 : layers.size() - 1;
+    if (layerActivations.empty()) {
+        layerActivations.assign(lyrCount, Activation::Sigmoid);
+    }
+    if (layerActivations.size() != lyrCount) {
+        throw std::invalid_argument("Need one activation for each layer");
+    }
+    for (size_t lyr = 0; (lyr < lyrCount); lyr++) {
+        if (layerActivations[lyr] == Activation::Softmax &&
+            (lyr + 1 < lyrCount || loss != Loss::CrossEntropy)) {
+            throw std::invalid_argument("Softmax can only be used on the "
+                                        "output layer with cross-entropy");
+        }
+    }
+    if (loss == Loss::CrossEntropy && lyrCount > 0 &&
+        layerActivations.back() != Activation::Sigmoid &&
+        layerActivations.back() != Activation::Softmax) {
+        throw std::invalid_argument("Cross-entropy needs sigmoid or softmax "
+                                    "outputs");
+    }
 
     // Use helper method to initializes matrices to default values.
     initBiasAndWeightMatrices(layers, biases, weights);
+    // Layers with ReLU or tanh do not learn from all-zero weights. So
+    // use small random values (He and Xavier initialization
+    // respectively) from a fixed seed to keep runs reproducible.
+    std::mt19937 rndGen;
+    for (size_t lyr = 0; (lyr < lyrCount); lyr++) {
+        const Activation act = layerActivations[lyr];
+        if (act == Activation::ReLU || act == Activation::Tanh) {
+            const Val gain = (act == Activation::ReLU) ? 2 : 1;
+            std::normal_distribution<Val> rndDist(0, std::sqrt(gain /
+                                                               layers[lyr]));
+            weights[lyr].applyInPlace([&](Val) { return rndDist(rndGen); });
+        }
+    }
 }
 
 // Helper method called from the constructor to initialize the biases
@@ -62,68 +111,270 @@ NeuralNet::initBiasAndWeightMatrices(const std::vector<int>& layerSizes,
 // layer in the neural network.
 void NeuralNet::learn(const Matrix& inputs, const Matrix& expected,
                       const Val eta) {
-    // First process the information by feeding inputs through each
-    // layer and recording the intermediate results.
-    auto activation = inputs;
+    // A single image is just a batch of size 1.
+    backprop(inputs, expected, workspace);
+    update(workspace, eta);
+}
 
-    // List of matrices to store the deltas and errors for each layer
-    MatrixVec activations = { inputs }, zs;
+// The mini-batch learning method that uses the gradient averaged over
+// all the images in the batch.
+void NeuralNet::learnBatch(const Matrix& inputs, const Matrix& expected,
+                           const Val eta) {
+    assert(inputs.cols == expected.cols);
+    backprop(inputs, expected, workspace);
+    update(workspace, eta / inputs.cols);
+}
 
-    // Do the forward propagation layer-by-layer
-    for (size_t lyr = 0; (lyr < biases.size()); lyr++) {
-        zs.push_back(weights[lyr].dot(activation) + biases[lyr]);
-        // Update activations for the next layer (i.e., next iteration)
-        activation = zs.back().apply(sigmoid);
-        // Store activations for each layer for use in backward-pass below.
-        activations.push_back(activation);
+// The data-parallel mini-batch learning method.
+void NeuralNet::learnBatch(const Matrix& inputs, const Matrix& expected,
+                           const Val eta, ThreadPool& pool) {
+    assert(inputs.cols == expected.cols);
+    const size_t threads = std::min(pool.size(), inputs.cols);
+    if (threads <= 1) {
+        learnBatch(inputs, expected, eta);
+        return;
     }
-    
-    // ----------------[ Now do the backward pass ]-----------------
-    // This pass computes nabla (∇) in weights and biases so that the
-    // network can be suitably updated to minimize errors.
-    auto delta = (activations.back() - expected) * zs.back().apply(invSigmoid);
+    workerSpaces.resize(threads);
+    // Each thread computes the gradients for its share of the batch.
+    pool.run([&](const size_t tid) {
+        if (tid >= threads) {
+            return;  // Fewer images in this batch than threads.
+        }
+        const size_t start = inputs.cols * tid / threads;
+        const size_t count = inputs.cols * (tid + 1) / threads - start;
+        Workspace& ws = workerSpaces[tid];
+        inputs.sliceColumns(start, count, ws.inputs);
+        expected.sliceColumns(start, count, ws.expected);
+        backprop(ws.inputs, ws.expected, ws);
+    });
+    // Now each thread reduces a disjoint range of the gradients from
+    // all the workspaces and applies it to the weights and biases.
+    NNET_PROFILE_SCOPE(Profiler::Phase::Update);
+    const Val rate = -eta / inputs.cols;
+    const MatrixKernels& kernels = matrixKernels();
+    pool.run([&](const size_t tid) {
+        const size_t workers = pool.size();
+        const auto reduce = [&](Matrix& dest, auto nabla) {
+            const size_t lo = dest.data.size() * tid / workers;
+            const size_t hi = dest.data.size() * (tid + 1) / workers;
+            for (size_t w = 0; (w < threads); w++) {
+                const Matrix& grad = nabla(workerSpaces[w]);
+                kernels.axpy(rate, grad.data.data() + lo,
+                             dest.data.data() + lo, hi - lo);
+            }
+        };
+        for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+            reduce(weights[lyr], [lyr](const Workspace& ws) -> const Matrix& {
+                                     return ws.nabla_w[lyr]; });
+            reduce(biases[lyr], [lyr](const Workspace& ws) -> const Matrix& {
+                                    return ws.nabla_b[lyr]; });
+        }
+    });
+}
 
+// The distributed mini-batch learning method.
+void NeuralNet::learnBatch(const Matrix& inputs, const Matrix& expected,
+                           const Val eta, Communicator& comm) {
+    if (comm.size() <= 1) {
+        learnBatch(inputs, expected, eta);
+        return;
+    }
+    assert(inputs.cols == expected.cols);
+    backprop(inputs, expected, workspace, &comm);
+    comm.waitAll();
+    // The gradients are now summed over the whole (global) batch.
+    update(workspace, eta / (inputs.cols * comm.size()));
+}
 
-    // Create intermediate bias and weights matrices to be updated as
-    // part of the back propagation.
-    MatrixVec nabla_b, nabla_w;
-    // Store the delta for use in the interations below
-    nabla_b.push_back(delta);
-    const int lastLyr = layerSizes.data.size() - 1;
-    nabla_w.push_back(delta.dot(activations.at(lastLyr - 1).transpose()));
+// The asynchronous (Hogwild) learning method.
+void NeuralNet::learnHogwild(const Matrix& inputs, const Matrix& expected,
+                             const Val eta, ThreadPool& pool) {
+    assert(inputs.cols == expected.cols);
+    const size_t threads = std::min(pool.size(), inputs.cols);
+    workerSpaces.resize(std::max<size_t>(threads, 1));
+    // Each thread learns from its share of the images one at a time.
+    // The weights and biases are read and updated by all the threads
+    // without synchronization (intentionally, see the header).
+    const auto learnShare = [&](const size_t tid) {
+        if (tid >= threads) {
+            return;  // Fewer images in this batch than threads.
+        }
+        const size_t start = inputs.cols * tid / threads;
+        const size_t end   = inputs.cols * (tid + 1) / threads;
+        Workspace& ws = workerSpaces[tid];
+        for (size_t col = start; (col < end); col++) {
+            inputs.sliceColumns(col, 1, ws.inputs);
+            expected.sliceColumns(col, 1, ws.expected);
+            backprop(ws.inputs, ws.expected, ws);
+            update(ws, eta);
+        }
+    };
+    if (threads <= 1) {
+        learnShare(0);
+    } else {
+        pool.run(learnShare);
+    }
+}
+
+// Copies the network on rank 0 to all the other ranks.
+void NeuralNet::broadcast(Communicator& comm) {
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        comm.broadcast(weights[lyr].data.data(), weights[lyr].data.size());
+        comm.broadcast(biases[lyr].data.data(), biases[lyr].data.size());
+    }
+}
+
+// Sizes the matrices in the workspace for a given batch size.
+void NeuralNet::reserve(Workspace& ws, const size_t batchSize) const {
+    const size_t lyrCount = weights.size();
+    ws.activations.resize(lyrCount);
+    ws.deltas.resize(lyrCount);
+    ws.nabla_b.resize(lyrCount);
+    ws.nabla_w.resize(lyrCount);
+    for (size_t lyr = 0; (lyr < lyrCount); lyr++) {
+        const size_t rows = layerSizes.data[lyr + 1];
+        ws.activations[lyr].resize(rows, batchSize);
+        ws.deltas[lyr].resize(rows, batchSize);
+        ws.nabla_b[lyr].resize(rows, 1);
+        ws.nabla_w[lyr].resize(rows, layerSizes.data[lyr]);
+    }
+}
+
+// Helper method to sum each row of a given matrix into a column
+// vector. This is used to accumulate the bias gradients of a batch.
+static void rowSums(const Matrix& mat, Matrix& result) {
+    result.resize(mat.rows, 1);
+    for (size_t row = 0; (row < mat.rows); row++) {
+        Val sum = 0;
+        for (size_t col = 0; (col < mat.cols); col++) {
+            sum += mat.data[row * mat.cols + col];
+        }
+        result.data[row] = sum;
+    }
+}
+
+// The forward and backward passes that compute the gradients for a
+// batch of images (one image per column) using the given workspace.
+void NeuralNet::backprop(const Matrix& inputs, const Matrix& expected,
+                         Workspace& ws, Communicator* comm) const {
+    assert(inputs.cols == expected.cols);
+    reserve(ws, inputs.cols);
+    const size_t lastLyr = weights.size() - 1;
+    // Convenience lambda to get the inputs to a given layer.
+    const auto layerInput = [&](const size_t lyr) -> const Matrix& {
+        return (lyr == 0) ? inputs : ws.activations[lyr - 1];
+    };
+
+    // First process the information by feeding inputs through each
+    // layer and recording the activations.  The weighted inputs (zs)
+    // are not needed, as the derivative of the sigmoid is computed
+    // from the activations.  So they are overwritten in place.
+    {
+        NNET_PROFILE_SCOPE(Profiler::Phase::Forward);
+        if (sparseInputs) {
+            // The sparse form is also used for the weight gradients.
+            ws.sparseInputs.assign(inputs);
+            feedForward(ws.sparseInputs, ws.activations[0],
+                        ws.activations[0]);
+        }
+        for (size_t lyr = (sparseInputs ? 1 : 0); (lyr <= lastLyr); lyr++) {
+            feedForward(lyr, layerInput(lyr), ws.activations[lyr],
+                        ws.activations[lyr]);
+        }
+    }
+
+    // ----------------[ Now do the backward pass ]-----------------
+    // This pass computes nabla (∇) in weights and biases so that the
+    // network can be suitably updated to minimize errors.  The
+    // derivative of the sigmoid is a * (1 - a) for each activation a,
+    // which avoids recomputing exponentials.
+    NNET_PROFILE_SCOPE(Profiler::Phase::Backward);
+    const auto mulDerivative = [&](const size_t lyr) {
+        withActivation(layerActivations[lyr], [&](auto policy) {
+            decltype(policy)::mulDerivative(ws.activations[lyr].data.data(),
+                                            ws.deltas[lyr].data.data(),
+                                            ws.deltas[lyr].data.size());
+        });
+    };
+    // With cross-entropy (and sigmoid or softmax outputs) the error of
+    // the outputs is just (a - y), as the derivative cancels out.
+    ws.deltas[lastLyr] = ws.activations[lastLyr];
+    ws.deltas[lastLyr] -= expected;
+    if (loss == Loss::Quadratic) {
+        mulDerivative(lastLyr);
+    }
 
     // We propagate the errors backwards (to correct weights and
-    // biases), from the outputs back to the inputs. Note that the
-    // order of zs and nabla values are from output to input order.
-    for (auto lyr = 2; (lyr <= lastLyr); lyr++) {
-        const auto sp = zs[lastLyr - lyr].apply(invSigmoid);
-        delta = weights[lastLyr - lyr + 1].transpose().dot(delta) * sp;
-        nabla_b.push_back(delta);
-        nabla_w.push_back(delta.dot(activations[lastLyr - lyr].transpose()));
+    // biases), from the outputs back to the inputs. The weight
+    // gradients computed via dotNT are sums over the batch.  The
+    // transposed operands are read in place (without any copies).
+    for (size_t lyr = lastLyr + 1; (lyr-- > 0);) {
+        const Matrix& delta = ws.deltas[lyr];
+        rowSums(delta, ws.nabla_b[lyr]);
+        if (lyr == 0 && sparseInputs) {
+            ws.sparseInputs.leftDotNT(delta, ws.nabla_w[lyr]);
+        } else {
+            delta.dotNT(layerInput(lyr), ws.nabla_w[lyr]);
+        }
+        if (comm != nullptr) {
+            // Sum this layer's gradients across the ranks while the
+            // errors of the earlier layers are computed.
+            comm->startAllreduce(ws.nabla_b[lyr].data.data(),
+                                 ws.nabla_b[lyr].data.size());
+            comm->startAllreduce(ws.nabla_w[lyr].data.data(),
+                                 ws.nabla_w[lyr].data.size());
+        }
+        if (lyr > 0) {
+            // Propagate the errors to the previous layer.
+            weights[lyr].dotTN(delta, ws.deltas[lyr - 1]);
+            mulDerivative(lyr - 1);
+            if (comm != nullptr) {
+                comm->progress();
+            }
+        }
+    }
+}
+
+// Updates the weights and biases using the gradients in a workspace.
+void NeuralNet::update(const Workspace& ws, const Val rate) {
+    NNET_PROFILE_SCOPE(Profiler::Phase::Update);
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        weights[lyr].addScaled(ws.nabla_w[lyr], -rate);
+        biases[lyr].addScaled(ws.nabla_b[lyr], -rate);
     }
+}
 
-    /* Debugging code
-    if ((nabla_b.back()[0][0] - nabla_b.back().back()[0]) > 0) {
-        std::cout << std::setprecision(17) << "nabla_b: "
-                  << nabla_b.back()[0][0] << " " << nabla_b.back().back()[0]
-                  << " " << nabla_b.back()[5][0]
-                  << '\n';
+// The fused forward pass for a given layer of the network.
+void NeuralNet::feedForward(const size_t lyr, const Matrix& input, Matrix& z,
+                            Matrix& activation) const {
+    weights[lyr].dotAddBias(input, biases[lyr], z);
+    if (&activation != &z) {
+        activation = z;  // Reuses the storage of activation
     }
-    */
+    withActivation(layerActivations[lyr], [&](auto policy) {
+        decltype(policy)::activate(activation.data.data(), activation.rows,
+                                   activation.cols);
+    });
+}
 
-    // Now finally update the weights and biases for each layer. Note
-    // that the previous loop computes nabla_b and nabla_w in reverse
-    // order. So here we use revLyr variabe to ease accounting for the
-    // reverse order in nabla_w and nabla_b
-    for (auto lyr = 0, revLyr = lastLyr - 1; (lyr < lastLyr); lyr++, revLyr--) {
-        weights[lyr] = weights[lyr] - (nabla_w[revLyr] * eta);
-        biases[lyr]  = biases[lyr]  - (nabla_b[revLyr] * eta);
+// The fused forward pass for the first layer using sparse inputs.
+void NeuralNet::feedForward(const SparseMatrix& input, Matrix& z,
+                            Matrix& activation) const {
+    input.leftDotAddBias(weights[0], biases[0], z);
+    if (&activation != &z) {
+        activation = z;  // Reuses the storage of activation
     }
+    withActivation(layerActivations[0], [&](auto policy) {
+        decltype(policy)::activate(activation.data.data(), activation.rows,
+                                   activation.cols);
+    });
 }
 
 // The stream insertion operator to save/write the neural network data
 // to a given file or output stream.
 std::ostream& operator<<(std::ostream& os, const NeuralNet& nnet) {
+    // Print enough digits so values are read back without any loss.
+    const auto prec = os.precision(std::numeric_limits<Val>::max_digits10);
     // First print the layer sizes
     os << nnet.layerSizes << '\n';
     // Next print the biases for each layer.
@@ -134,6 +385,7 @@ std::ostream& operator<<(std::ostream& os, const NeuralNet& nnet) {
     for (const auto& weight : nnet.weights) {
         os << weight << '\n';
     }
+    os.precision(prec);
     // Return the output stream as per convention
     return os;
 }
@@ -143,15 +395,26 @@ std::ostream& operator<<(std::ostream& os, const NeuralNet& nnet) {
 std::istream& operator>>(std::istream& is, NeuralNet& nnet) {
     // First load the layer sizes
     is >> nnet.layerSizes;
+    // There is one less set of biases and weights than layers, as
+    // the input layer does not have any.
     const int layerCount = nnet.layerSizes.data.size();
+    nnet.biases.clear();
+    nnet.weights.clear();
+    // The text format does not include the activation functions. So
+    // keep the ones of nnet unless the number of layers changed.
+    if (nnet.layerActivations.size() + 1 != size_t(layerCount)) {
+        nnet.layerActivations.assign(std::max(layerCount - 1, 0),
+                                     Activation::Sigmoid);
+        nnet.loss = Loss::Quadratic;
+    }
     // Now read the biases for each layer
     Matrix temp;
-    for (int i = 0; (i < layerCount); i++) {
+    for (int i = 1; (i < layerCount); i++) {
         is >> temp;
         nnet.biases.push_back(temp);
     }
     // Now read the weights for each layer
-    for (int i = 0; (i < layerCount); i++) {
+    for (int i = 1; (i < layerCount); i++) {
         is >> temp;
         nnet.weights.push_back(temp);
     }
@@ -159,15 +422,301 @@ std::istream& operator>>(std::istream& is, NeuralNet& nnet) {
     return is;    
 }
 
+// The magic number at the start of a binary checkpoint file.
+static constexpr char CheckpointMagic[8] = {'N', 'N', 'E', 'T',
+                                            'C', 'K', 'P', 'T'};
+
+// Used to detect checkpoints written on a machine with a different
+// byte order.
+static constexpr uint32_t CheckpointEndianTag = 0x01020304;
+
+// The fixed part of the checkpoint header (before the layer sizes).
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t valSize;
+    uint32_t endianTag;
+    uint32_t layerCount;
+};
+
+// Rounds up a given offset to the alignment of the checkpoint blocks.
+static size_t alignCheckpoint(const size_t offset) {
+    return (offset + NeuralNet::CheckpointAlign - 1) /
+        NeuralNet::CheckpointAlign * NeuralNet::CheckpointAlign;
+}
+
+// Helper method to convert a block of values in a checkpoint (which
+// may have been written with a different Val type) into a matrix.
+template<typename T>
+static void copyCheckpointBlock(const uint8_t* src, Matrix& dest) {
+    if (std::is_same<T, Val>::value) {
+        std::memcpy(dest.data.data(), src, dest.data.size() * sizeof(Val));
+        return;
+    }
+    const T* vals = reinterpret_cast<const T*>(src);
+    std::copy_n(vals, dest.data.size(), dest.data.begin());
+}
+
+void NeuralNet::saveCheckpoint(const std::string& file) const {
+    std::ofstream os(file, std::ios::binary);
+    if (!os) {
+        throw std::runtime_error("Unable to write " + file);
+    }
+    // Helper lambda to write zeros up to the next aligned offset.
+    const char zeros[CheckpointAlign] = {};
+    const auto pad = [&]() {
+        const size_t pos = os.tellp();
+        os.write(zeros, alignCheckpoint(pos) - pos);
+    };
+    CheckpointHeader hdr;
+    std::copy_n(CheckpointMagic, sizeof(hdr.magic), hdr.magic);
+    hdr.version    = CheckpointVersion;
+    hdr.valSize    = sizeof(Val);
+    hdr.endianTag  = CheckpointEndianTag;
+    hdr.layerCount = layerSizes.data.size();
+    os.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    // Helper lambda to write a 32-bit value.
+    const auto write32 = [&](const uint32_t val) {
+        os.write(reinterpret_cast<const char*>(&val), sizeof(val));
+    };
+    for (const Val size : layerSizes.data) {
+        write32(size);
+    }
+    write32(static_cast<uint32_t>(loss));
+    for (const Activation act : layerActivations) {
+        write32(static_cast<uint32_t>(act));
+    }
+    pad();
+    // Write the biases and weights of each layer as aligned blocks.
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        for (const Matrix* mat : {&biases[lyr], &weights[lyr]}) {
+            os.write(reinterpret_cast<const char*>(mat->data.data()),
+                     mat->data.size() * sizeof(Val));
+            pad();
+        }
+    }
+    if (!os.good()) {
+        throw std::runtime_error("Error writing: " + file);
+    }
+}
+
+NeuralNet NeuralNet::loadCheckpoint(const std::string& file) {
+    const int fd = open(file.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        if (fd != -1) close(fd);
+        throw std::runtime_error("Unable to read " + file);
+    }
+    const size_t mappedSize = info.st_size;
+    void* mapping = (mappedSize > 0) ?
+        mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);  // The mapping remains valid after the file is closed
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Unable to map " + file);
+    }
+    // Release the mapping when this method returns or throws (for
+    // example, if the network cannot be created below).
+    const auto unmap = [mappedSize](void* ptr) { munmap(ptr, mappedSize); };
+    const std::unique_ptr<void, decltype(unmap)> guard(mapping, unmap);
+    // Helper lambda to report errors below.
+    const auto fail = [&](const std::string& msg) {
+        throw std::runtime_error(msg + file);
+    };
+    // Validate the header and the layer sizes.
+    const uint8_t* bytes = static_cast<const uint8_t*>(mapping);
+    CheckpointHeader hdr;
+    if (mappedSize < sizeof(hdr)) {
+        fail("Not a checkpoint: ");
+    }
+    std::memcpy(&hdr, bytes, sizeof(hdr));
+    if (!std::equal(hdr.magic, hdr.magic + sizeof(hdr.magic),
+                    CheckpointMagic)) {
+        fail("Not a checkpoint: ");
+    }
+    if (hdr.version < 1 || hdr.version > CheckpointVersion ||
+        hdr.endianTag != CheckpointEndianTag ||
+        (hdr.valSize != sizeof(float) && hdr.valSize != sizeof(double))) {
+        fail("Unsupported checkpoint version or format: ");
+    }
+    // Version 1 did not store the loss and activations (which were
+    // always quadratic and sigmoid).
+    const size_t extras = (hdr.version >= 2) ? hdr.layerCount : 0;
+    const size_t sizesEnd = sizeof(hdr) +
+        (hdr.layerCount + extras) * sizeof(uint32_t);
+    if (hdr.layerCount < 2 || hdr.layerCount > mappedSize ||
+        sizesEnd > mappedSize) {
+        fail("Invalid layer count in checkpoint: ");
+    }
+    // Helper lambda to read the i-th 32-bit value after the header.
+    const auto read32 = [&](const size_t i) {
+        uint32_t val;
+        std::memcpy(&val, bytes + sizeof(hdr) + i * sizeof(val), sizeof(val));
+        return val;
+    };
+    std::vector<int> layers(hdr.layerCount);
+    for (size_t i = 0; (i < layers.size()); i++) {
+        const uint32_t neurons = read32(i);
+        if (neurons == 0 || neurons > mappedSize) {
+            fail("Invalid layer size in checkpoint: ");
+        }
+        layers[i] = neurons;
+    }
+    Loss loss = Loss::Quadratic;
+    std::vector<Activation> activations;
+    if (extras > 0) {
+        if (read32(layers.size()) > uint32_t(Loss::CrossEntropy)) {
+            fail("Invalid loss in checkpoint: ");
+        }
+        loss = static_cast<Loss>(read32(layers.size()));
+        for (size_t i = 1; (i < layers.size()); i++) {
+            const uint32_t act = read32(layers.size() + i);
+            if (act > uint32_t(Activation::Softmax)) {
+                fail("Invalid activation in checkpoint: ");
+            }
+            activations.push_back(static_cast<Activation>(act));
+        }
+    }
+    // Check that all the blocks are present before creating the net.
+    size_t offset = alignCheckpoint(sizesEnd), end = offset;
+    for (size_t lyr = 1; (lyr < layers.size()); lyr++) {
+        const size_t rows = layers[lyr], cols = layers[lyr - 1];
+        end    = offset + rows * hdr.valSize;
+        offset = alignCheckpoint(end);
+        end    = offset + rows * cols * hdr.valSize;
+        offset = alignCheckpoint(end);
+    }
+    if (end > mappedSize) {
+        fail("Truncated checkpoint: ");
+    }
+    // Copy each aligned block directly into the matrices.
+    NeuralNet net(layers, activations, loss);
+    offset = alignCheckpoint(sizesEnd);
+    for (size_t lyr = 0; (lyr < net.weights.size()); lyr++) {
+        for (Matrix* mat : {&net.biases[lyr], &net.weights[lyr]}) {
+            if (hdr.valSize == sizeof(double)) {
+                copyCheckpointBlock<double>(bytes + offset, *mat);
+            } else {
+                copyCheckpointBlock<float>(bytes + offset, *mat);
+            }
+            offset = alignCheckpoint(offset + mat->data.size() * hdr.valSize);
+        }
+    }
+    return net;
+}
 
 // The method to classify/recognize a given input.
 Matrix
 NeuralNet::classify(const Matrix& inputs) const {
-    Matrix result = inputs;
+    // The fused forward pass alternates between the two matrices.
+    // The inputs are used in place rather than copied.
+    Matrix result, z;
+    const Matrix* layerInput = &inputs;
     for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
-        result = (weights[lyr].dot(result) + biases[lyr]).apply(sigmoid);
+        feedForward(lyr, *layerInput, z, z);
+        std::swap(result, z);
+        layerInput = &result;
+    }
+    return (layerInput == &inputs) ? inputs : result;
+}
+
+// Classify a batch of images and return the index of the maximum
+// output for each column.
+std::vector<int>
+NeuralNet::classifyBatch(const Matrix& inputs) const {
+    // The fused forward pass alternates between the two matrices.
+    Matrix result, z;
+    const Matrix* layerInput = &inputs;
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        if (lyr == 0 && sparseInputs) {
+            SparseMatrix sparse;
+            sparse.assign(inputs);
+            feedForward(sparse, z, z);
+        } else {
+            feedForward(lyr, *layerInput, z, z);
+        }
+        std::swap(result, z);
+        layerInput = &result;
+    }
+    // Find the index of the maximum output in each column.
+    std::vector<int> labels(inputs.cols, 0);
+    for (size_t row = 1; (row < result.rows); row++) {
+        const Val* rowVals = &result.data[row * result.cols];
+        for (size_t col = 0; (col < result.cols); col++) {
+            if (rowVals[col] > result.data[labels[col] * result.cols + col]) {
+                labels[col] = row;
+            }
+        }
+    }
+    return labels;
+}
+
+const Val*
+NeuralNet::predictOutputs(const float* pixels) const {
+    assert(!weights.empty());
+    // Size the scratch buffers for the largest layer.  These are
+    // allocated just once per thread (or if a larger net is used).
+    size_t maxSize = weights[0].cols;
+    for (const auto& w : weights) {
+        maxSize = std::max(maxSize, w.rows);
+    }
+    thread_local std::vector<Val> bufA, bufB;
+    if (bufA.size() < maxSize) {
+        bufA.resize(maxSize);
+        bufB.resize(maxSize);
+    }
+    std::copy_n(pixels, weights[0].cols, bufA.data());
+    // Each layer is a matrix-vector product with contiguous rows of
+    // the weights followed by the activation function of the layer.
+    const MatrixKernels& kernels = matrixKernels();
+    Val *in = bufA.data(), *out = bufB.data();
+    for (size_t lyr = 0; (lyr < weights.size()); lyr++) {
+        const Matrix& w = weights[lyr];
+        for (size_t row = 0; (row < w.rows); row++) {
+            out[row] = biases[lyr].data[row] +
+                kernels.dot(&w.data[row * w.cols], in, w.cols);
+        }
+        withActivation(layerActivations[lyr], [&](auto policy) {
+            decltype(policy)::activate(out, w.rows, 1);
+        });
+        std::swap(in, out);
+    }
+    return in;
+}
+
+int
+NeuralNet::predict(const float* pixels) const {
+    const Val* outputs = predictOutputs(pixels);
+    return std::max_element(outputs, outputs + weights.back().rows) - outputs;
+}
+
+size_t
+NeuralNet::predictTopK(const float* pixels, const size_t k, int* labels,
+                       Val* scores) const {
+    const Val* outputs = predictOutputs(pixels);
+    const size_t count = weights.back().rows, topK = std::min(k, count);
+    const Val total = std::accumulate(outputs, outputs + count, Val(0));
+    // Insertion sort into the (short) list of the top k outputs.  A
+    // later output only displaces an earlier one with a lower score
+    // so ties are ordered by index (as in predict).
+    for (size_t i = 0, used = 0; (i < count); i++) {
+        size_t pos = std::min(used, topK);
+        while (pos > 0 && outputs[labels[pos - 1]] < outputs[i]) {
+            if (pos < topK) {
+                labels[pos] = labels[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < topK) {
+            labels[pos] = i;
+            used = std::min(used + 1, topK);
+        }
+    }
+    if (scores != nullptr) {
+        for (size_t i = 0; (i < topK); i++) {
+            scores[i] = (total > 0) ? outputs[labels[i]] / total : 0;
+        }
     }
-    return result;
+    return topK;
 }
 
 #endif
@@ -14,8 +14,18 @@
 #include <vector>
 #include <tuple>
 #include <string>
+#include <cstdint>
 #include <cstdlib>
+#include <cmath>
 #include "Matrix.h"
+#include "ThreadPool.h"
+#include "Communicator.h"
+#include "Activations.h"
+#include "SparseVector.h"
+
+// The version of the network with a compile-time topology.
+template<size_t... Sizes>
+class FixedNeuralNet;
 
 // A vector containing a list of doubles
 using DoubleVec = std::vector<double>;
@@ -55,7 +65,56 @@ class NeuralNet {
      */
     friend std::istream& operator>>(std::istream& is, NeuralNet& nnet);    
 
+    /**
+     * The int8 version of the network reads the weights and biases
+     * to quantize them.
+     */
+    friend class QuantizedNet;
+
+    /**
+     * The fixed-topology version of the network copies the weights and
+     * biases to share the checkpoint format.
+     */
+    template<size_t... Sizes>
+    friend class FixedNeuralNet;
+
+    /**
+     * The GPU version of the network copies the weights and biases to
+     * and from device memory.
+     */
+    friend class GpuNet;
+
 public:
+    /**
+     * The reusable buffers used by the forward and backward passes.
+     * All the matrices are sized per layer (from layerSizes) and for
+     * the number of images in a batch.  Since Matrix::resize reuses
+     * storage, once a workspace has been used for the largest batch
+     * size, subsequent training does not allocate memory.
+     */
+    struct Workspace {
+        /** The activations (f(z)) for each layer */
+        MatrixVec activations;
+
+        /** The errors (deltas) for each layer */
+        MatrixVec deltas;
+
+        /** The gradients of the biases for each layer */
+        MatrixVec nabla_b;
+
+        /** The gradients of the weights for each layer */
+        MatrixVec nabla_w;
+
+        /** The share of the input images used by a worker thread */
+        Matrix inputs;
+
+        /** The expected outputs for the images in inputs */
+        Matrix expected;
+
+        /** The sparse form of the inputs (see setSparseInputs) */
+        SparseMatrix sparseInputs;
+    };
+
     /**
      * Creates a neural network with a given number of layers with a
      * given number of neurons at each layer. For example NeuralNet
@@ -65,8 +124,21 @@ public:
      *
      * \param[in] layers The layers and number of neurons on each
      * layer.x
+     *
+     * \param[in] activations The activation function for each layer
+     * after the inputs (i.e., layers.size() - 1 entries).  If this
+     * list is empty, all layers use the sigmoid.  Layers using ReLU
+     * or tanh start with small random weights (from a fixed seed) as
+     * such layers cannot learn from all-zero weights.
+     *
+     * \param[in] loss The cost function to be minimized. Softmax can
+     * only be used on the output layer with Loss::CrossEntropy, and
+     * cross-entropy needs sigmoid or softmax outputs.  An exception
+     * is thrown for invalid combinations.
      */
-    NeuralNet(const std::vector<int>& layers);
+    NeuralNet(const std::vector<int>& layers,
+              const std::vector<Activation>& activations = {},
+              const Loss loss = Loss::Quadratic);
 
     /**
      * The helper method that updates the weights and biases of the
@@ -87,6 +159,107 @@ public:
     void learn(const Matrix& inputs, const Matrix& expected,
                const Val eta = 0.3);
 
+    /**
+     * Mini-batch version of the learn method.  This method runs the
+     * forward and backward passes on a whole batch of images at once
+     * (so that each layer is a matrix-matrix product) and then
+     * updates the weights and biases using the gradient averaged
+     * over the batch.
+     *
+     * \param[in] inputs The input images, one image per column.  The
+     * number of rows must be exactly the same as the number of input
+     * neurons for this neural network.
+     *
+     * \param[in] expected The expected outputs, one column per
+     * image.  This matrix should have the same number of rows as the
+     * output layer and the same number of columns as \c inputs.
+     *
+     * \param[in] eta The learning rate at which this neural network
+     * is to learn from this batch of examples.
+     */
+    void learnBatch(const Matrix& inputs, const Matrix& expected,
+                    const Val eta = 0.3);
+
+    /**
+     * Data-parallel version of learnBatch.  The columns of the batch
+     * are split evenly between the threads in the given pool, each
+     * thread computes the gradients for its share of the images into
+     * its own workspace, and finally the gradients are reduced and
+     * applied to the weights and biases in parallel.  The reduction
+     * is lock-free as each thread sums up a disjoint range of values
+     * from all of the workspaces.
+     *
+     * \param[in] inputs The input images, one image per column.
+     *
+     * \param[in] expected The expected outputs, one column per image.
+     *
+     * \param[in] eta The learning rate at which this neural network
+     * is to learn from this batch of examples.
+     *
+     * \param[in] pool The threads to be used.  With a single thread
+     * this method is the same as the serial learnBatch.
+     */
+    void learnBatch(const Matrix& inputs, const Matrix& expected,
+                    const Val eta, ThreadPool& pool);
+
+    /**
+     * Distributed version of learnBatch.  Each rank passes its own
+     * share of a mini-batch, and the gradients are summed across the
+     * ranks so that every rank applies the same update (and hence the
+     * networks stay identical).  The sum of the gradients for each
+     * layer is started as soon as the backward pass has computed
+     * them, so that the communication overlaps with the backward pass
+     * of the earlier layers.
+     *
+     * \param[in] inputs This rank's share of the input images, one
+     * image per column.  All the ranks must pass the same number of
+     * images.
+     *
+     * \param[in] expected The expected outputs, one column per image.
+     *
+     * \param[in] eta The learning rate at which this neural network
+     * is to learn from this batch of examples.
+     *
+     * \param[in,out] comm The ranks training this network.  With a
+     * single rank this method is the same as the serial learnBatch.
+     */
+    void learnBatch(const Matrix& inputs, const Matrix& expected,
+                    const Val eta, Communicator& comm);
+
+    /**
+     * Asynchronous (Hogwild-style) version of learn.  The images are
+     * split evenly between the threads in the given pool and each
+     * thread runs learn on its images one at a time.  The threads
+     * update the shared weights and biases after every image without
+     * any locks or barriers, so an update may occasionally overwrite
+     * a concurrent one.  As each update of this small network is
+     * tiny, such conflicts are rare and do not hurt convergence,
+     * while the threads never wait for each other.
+     *
+     * Unlike learnBatch, the result is not deterministic when more
+     * than one thread is used.
+     *
+     * \param[in] inputs The input images, one image per column.
+     *
+     * \param[in] expected The expected outputs, one column per image.
+     *
+     * \param[in] eta The learning rate used for every image.
+     *
+     * \param[in] pool The threads to be used.  With a single thread
+     * this method is the same as calling learn for each image.
+     */
+    void learnHogwild(const Matrix& inputs, const Matrix& expected,
+                      const Val eta, ThreadPool& pool);
+
+    /**
+     * Copies the weights and biases of rank 0 to all the other ranks.
+     * This is used before distributed training so that all the ranks
+     * start from the same network.
+     *
+     * \param[in,out] comm The ranks training this network.
+     */
+    void broadcast(Communicator& comm);
+
     /**
      * This method is used to classify or recognize a given image
      * based on the current learning by this neural network.
@@ -101,6 +274,86 @@ public:
      */
     Matrix classify(const Matrix& inputs) const;
 
+    /**
+     * Classifies a batch of images at once and returns the digit (the
+     * index of the output neuron with the highest activation) for
+     * each image.  This method does not modify the network and hence
+     * it can be called concurrently from multiple threads.
+     *
+     * \param[in] inputs The input images, one image per column.  The
+     * number of rows must be exactly the same as the number of input
+     * neurons for this neural network.
+     *
+     * \return The index of the maximum output for each image (one
+     * entry per column in inputs).
+     */
+    std::vector<int> classifyBatch(const Matrix& inputs) const;
+
+    /**
+     * Sets whether the first layer uses the sparse form of its inputs
+     * (see SparseMatrix).  When enabled, each batch passed to the
+     * learn, learnBatch, learnHogwild, and classifyBatch methods is
+     * converted to the sparse form (by the thread using it), and the
+     * forward pass and the weight gradients of the first layer skip
+     * the zero inputs.  For images with mostly zero pixels (such as
+     * digits) this is faster when each thread handles a few images at
+     * a time (as in learn and learnHogwild).  With wider batches, the
+     * matrix-matrix products of the dense form are faster.  The
+     * results are the same (up to rounding) either way.  By default,
+     * the dense form is used.
+     *
+     * \param[in] sparse If true, use the sparse form of the inputs.
+     */
+    void setSparseInputs(const bool sparse) { sparseInputs = sparse; }
+
+    /**
+     * Returns the number of input neurons (i.e., the number of pixels
+     * in each image) of this network.
+     *
+     * \return The number of inputs to the first layer.
+     */
+    size_t inputSize() const { return size_t(layerSizes.data[0]); }
+
+    /**
+     * Low-latency classification of a single image.  Unlike classify,
+     * this method does not create any matrices.  Instead, it runs the
+     * forward pass on scratch buffers owned by the calling thread,
+     * which are allocated only by the first call in each thread.
+     * This method does not modify the network and hence it can be
+     * called concurrently from many threads on a shared network.
+     *
+     * \param[in] pixels The normalized pixels (0 to 1.0, as returned
+     * by loadPGM) of the image.  The number of pixels must be exactly
+     * the same as the number of input neurons for this network.
+     *
+     * \return The index of the output neuron with the highest
+     * activation (i.e., the digit).
+     */
+    int predict(const float* pixels) const;
+
+    /**
+     * Variant of predict that returns the most likely k outputs along
+     * with their scores.  The scores are the activations of the
+     * output neurons normalized so all the outputs sum to 1.0.  Like
+     * predict, this method does not allocate memory after the first
+     * call in each thread and is thread-safe.
+     *
+     * \param[in] pixels The normalized pixels of the image.
+     *
+     * \param[in] k The number of outputs to be returned.
+     *
+     * \param[out] labels The array for the indexes of the top k
+     * outputs, in decreasing order of score.
+     *
+     * \param[out] scores An optional array (can be nullptr) for the
+     * score of each of the top k outputs.
+     *
+     * \return The number of entries stored, which is the smaller of k
+     * and the number of output neurons.
+     */
+    size_t predictTopK(const float* pixels, const size_t k, int* labels,
+                       Val* scores = nullptr) const;
+
     /**
      * This method is the top-level training method that processes
      * multiple input images and calling the learn method in this
@@ -111,7 +364,95 @@ public:
      */
     void train(const std::string& path);
 
+    /**
+     * Saves the layer sizes, biases, and weights of this network to a
+     * versioned binary checkpoint file.  Unlike the stream insertion
+     * operator, the values are written as-is (without any loss of
+     * precision) in the following layout:
+     *
+     * <ul>
+     * <li>The header: the 8-byte magic "NNETCKPT", followed by the
+     * 32-bit version, the size of each value in bytes (4 for float
+     * and 8 for double), the endianness tag 0x01020304, and the
+     * number of layers.  Then the 32-bit size of each layer, the
+     * Loss, and the Activation of each layer after the inputs (the
+     * last two only in version 2 and later).</li>
+     *
+     * <li>For each layer after the inputs: the biases followed by the
+     * row-major weights.</li>
+     * </ul>
+     *
+     * The header and each block of values start at a multiple of
+     * CheckpointAlign bytes, so the blocks can be used straight out
+     * of a memory-mapped file.
+     *
+     * \param[in] file The path of the checkpoint to be created.  An
+     * exception is thrown if the file cannot be written.
+     */
+    void saveCheckpoint(const std::string& file) const;
+
+    /**
+     * Creates a network from a checkpoint written by saveCheckpoint.
+     * The file is memory-mapped and each block of values is copied
+     * directly into the matrices of the network without any parsing.
+     * Checkpoints written with the other Val type (float or double)
+     * are converted while they are loaded.
+     *
+     * \param[in] file The path of the checkpoint to be loaded.  An
+     * exception is thrown if the file cannot be read or is not a
+     * valid checkpoint.
+     *
+     * \return The network with the layers, biases, and weights from
+     * the checkpoint.
+     */
+    static NeuralNet loadCheckpoint(const std::string& file);
+
+    /** The current version of the checkpoint format */
+    static constexpr uint32_t CheckpointVersion = 2;
+
+    /** The alignment (in bytes) of each block in a checkpoint file */
+    static constexpr size_t CheckpointAlign = 64;
+
 protected:
+    /**
+     * Sizes the matrices in a given workspace for the layers in this
+     * network and a given batch size.
+     *
+     * \param[out] ws The workspace to be sized.
+     *
+     * \param[in] batchSize The number of images in each batch.
+     */
+    void reserve(Workspace& ws, const size_t batchSize) const;
+
+    /**
+     * Runs the forward and backward passes for a batch of images and
+     * stores the (summed) gradients in nabla_b and nabla_w of the
+     * given workspace.  This method does not change the network.
+     *
+     * \param[in] inputs The input images, one image per column.
+     *
+     * \param[in] expected The expected outputs, one column per image.
+     *
+     * \param[in,out] ws The workspace to be used for the computation.
+     *
+     * \param[in,out] comm If not nullptr, the sums of the gradients of
+     * each layer across the ranks are started (but not waited for) as
+     * soon as they are computed.
+     */
+    void backprop(const Matrix& inputs, const Matrix& expected,
+                  Workspace& ws, Communicator* comm = nullptr) const;
+
+    /**
+     * Updates the weights and biases of this network using the
+     * gradients in a given workspace.
+     *
+     * \param[in] ws The workspace with the gradients from backprop.
+     *
+     * \param[in] rate The factor by which the gradients are scaled
+     * before they are subtracted from the weights and biases.
+     */
+    void update(const Workspace& ws, const Val rate);
+
     /**
      * This is an internal helper method that is used to initializes
      * the biases and weights matrix values for each layer.  This
@@ -141,18 +482,54 @@ protected:
         return 1. / (1. + std::exp(-val));
     }
 
-    
     /**
-     * A simple inverse-sigmoid function.
+     * The fused forward pass for one layer of the network.  This
+     * method computes the weighted inputs z = w . input + b (with
+     * the biases added to each column) and the activations f(z),
+     * using the activation function f of the layer, into
+     * caller-provided matrices.
+     *
+     * \param[in] lyr The index of the layer (0 is the first layer
+     * after the inputs).
      *
-     * \param[in] val The value whose inverse sigmoid value is to be
-     * returned.
+     * \param[in] input The activations from the previous layer, one
+     * column per image.
      *
-     * \return The inverse sigmoid value for the given val.
+     * \param[out] z The weighted inputs to this layer.
+     *
+     * \param[out] activation The activations of this layer.  This
+     * can be the same matrix as z if the weighted inputs are not
+     * needed.
      */
-    static Val invSigmoid(const Val val) {
-        return sigmoid(val) * (1 - sigmoid(val));
-    }
+    void feedForward(const size_t lyr, const Matrix& input, Matrix& z,
+                     Matrix& activation) const;
+
+    /**
+     * The fused forward pass for the first layer using the sparse
+     * form of the inputs.  This is the same as feedForward(0, ...)
+     * except that the zero inputs are skipped.
+     *
+     * \param[in] input The non-zero inputs, one column per image.
+     *
+     * \param[out] z The weighted inputs to the first layer.
+     *
+     * \param[out] activation The activations of the first layer.
+     * This can be the same matrix as z.
+     */
+    void feedForward(const SparseMatrix& input, Matrix& z,
+                     Matrix& activation) const;
+
+    /**
+     * The forward pass for a single image used by predict and
+     * predictTopK.  The pass ping-pongs between two scratch buffers
+     * owned by the calling thread.
+     *
+     * \param[in] pixels The pixels of the image.
+     *
+     * \return The activations of the output layer.  These values
+     * are valid until the next call to this method by this thread.
+     */
+    const Val* predictOutputs(const float* pixels) const;
 
 private:
     /**
@@ -172,6 +549,32 @@ private:
      * network.
      */
     Matrix layerSizes;
+
+    /**
+     * The activation function used by each layer after the inputs.
+     */
+    std::vector<Activation> layerActivations;
+
+    /**
+     * The cost function minimized by learn and learnBatch.
+     */
+    Loss loss;
+
+    /**
+     * If true, the first layer uses the sparse form of its inputs.
+     */
+    bool sparseInputs = false;
+
+    /**
+     * The buffers reused by learn and learnBatch for each call.
+     */
+    Workspace workspace;
+
+    /**
+     * The buffers used by each thread in the data-parallel version
+     * of learnBatch and in learnHogwild.
+     */
+    std::vector<Workspace> workerSpaces;
 };
 
 #endif
@@ -0,0 +1,158 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef NUMA_CPP
+#define NUMA_CPP
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include "Numa.h"
+
+namespace {
+
+// The CPUs (allowed for this process) on each node and the node of
+// each CPU, read once from sysfs.
+struct Topology {
+    std::vector<std::vector<int>> nodeCpus;
+    std::vector<size_t> cpuNode;
+};
+
+// Parses a list of CPUs in sysfs format (for example, "0-3,8-11").
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream is(list);
+    for (std::string range; std::getline(is, range, ',');) {
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last  = (dash == std::string::npos) ? first :
+            std::stoi(range.substr(dash + 1));
+        for (int cpu = first; (cpu <= last); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Reads the topology, ignoring the CPUs this process may not use (for
+// example, when started via taskset or by a batch scheduler) and the
+// nodes without any CPUs.  Node IDs need not be contiguous, so the
+// nodes are renumbered from 0.
+Topology readTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool haveMask =
+        (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    Topology topo;
+    // Node IDs are small, so looking for the first 1024 is enough.
+    for (int id = 0; (id < 1024); id++) {
+        std::ifstream is("/sys/devices/system/node/node" +
+                         std::to_string(id) + "/cpulist");
+        std::string list;
+        if (!std::getline(is, list) || list.empty()) {
+            continue;
+        }
+        std::vector<int> cpus;
+        for (const int cpu : parseCpuList(list)) {
+            if (!haveMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topo.nodeCpus.push_back(std::move(cpus));
+        }
+    }
+    if (topo.nodeCpus.empty()) {
+        // No sysfs, so treat all the allowed CPUs as a single node.
+        topo.nodeCpus.emplace_back();
+        for (int cpu = 0; (cpu < CPU_SETSIZE); cpu++) {
+            if (!haveMask || CPU_ISSET(cpu, &allowed)) {
+                topo.nodeCpus[0].push_back(cpu);
+            }
+        }
+    }
+    for (size_t node = 0; (node < topo.nodeCpus.size()); node++) {
+        for (const int cpu : topo.nodeCpus[node]) {
+            topo.cpuNode.resize(std::max<size_t>(topo.cpuNode.size(),
+                                                 cpu + 1), 0);
+            topo.cpuNode[cpu] = node;
+        }
+    }
+    return topo;
+}
+
+// The topology is read by the first thread that needs it.
+const Topology& topology() {
+    static const Topology topo = readTopology();
+    return topo;
+}
+
+// The node of the calling thread, set when the thread is pinned (via
+// pinThread), and -1 for threads that are not pinned.
+thread_local int threadNode = -1;
+
+}  // namespace
+
+size_t Numa::nodeCount() {
+    return topology().nodeCpus.size();
+}
+
+size_t Numa::cpuCount() {
+    size_t count = 0;
+    for (const std::vector<int>& node : topology().nodeCpus) {
+        count += node.size();
+    }
+    return std::max<size_t>(count, 1);
+}
+
+size_t Numa::nodeOfCpu(const int cpu) {
+    const std::vector<size_t>& cpuNode = topology().cpuNode;
+    return (cpu >= 0 && size_t(cpu) < cpuNode.size()) ? cpuNode[cpu] : 0;
+}
+
+std::vector<int> Numa::cpuOrder(const Pinning pinning) {
+    const std::vector<std::vector<int>>& nodeCpus = topology().nodeCpus;
+    std::vector<int> cpus;
+    if (pinning == Pinning::Compact) {
+        for (const std::vector<int>& node : nodeCpus) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+    } else if (pinning == Pinning::Scatter) {
+        // Take the i-th CPU of every node before the (i+1)-th.
+        size_t maxCpus = 0;
+        for (const std::vector<int>& node : nodeCpus) {
+            maxCpus = std::max(maxCpus, node.size());
+        }
+        for (size_t i = 0; (i < maxCpus); i++) {
+            for (const std::vector<int>& node : nodeCpus) {
+                if (i < node.size()) {
+                    cpus.push_back(node[i]);
+                }
+            }
+        }
+    }
+    return cpus;
+}
+
+bool Numa::pinThread(const int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+    threadNode = nodeOfCpu(cpu);
+    return true;
+}
+
+size_t Numa::currentNode() {
+    if (threadNode >= 0) {
+        return threadNode;
+    }
+    // Threads that are not pinned can move between nodes, so their
+    // node is looked up on every call rather than cached.
+    return (nodeCount() > 1) ? nodeOfCpu(sched_getcpu()) : 0;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+/** \file Numa.h Placement of threads and memory on NUMA nodes.
+
+    This file contains the few helpers used to run the training and
+    assessment threads on multi-socket machines, where each socket
+    (NUMA node) has its own memory and reading the memory of another
+    node is noticeably slower.  The topology is read from sysfs
+    (/sys/devices/system/node), so no additional libraries are needed.
+    Threads are pinned to cores (see ThreadPool) so that they stay on
+    one node, and read-mostly data is replicated on each node used
+    (see Replicated).  Linux allocates the pages of memory on the node
+    of the thread that first touches (i.e., writes) them, so each copy
+    is made by a thread running on its node.
+
+    On a machine with a single node (or if sysfs is not available)
+    there is just one node and nothing is replicated.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+/** The NUMA topology and the helpers to place threads and data */
+namespace Numa {
+
+/** The ways in which the threads of a ThreadPool are pinned to cores */
+enum class Pinning {
+    None,     ///< The threads are not pinned (the default).
+    Compact,  ///< The threads fill the cores of one node before the next.
+    Scatter   ///< The threads are spread round-robin across the nodes.
+};
+
+/**
+ * Returns the pinning for a given name, which is one of "none",
+ * "compact", or "scatter".  An exception is thrown for any other name.
+ *
+ * \param[in] name The name of the pinning.
+ *
+ * \return The corresponding pinning.
+ */
+inline Pinning parsePinning(const std::string& name) {
+    if (name == "none")    return Pinning::None;
+    if (name == "compact") return Pinning::Compact;
+    if (name == "scatter") return Pinning::Scatter;
+    throw std::invalid_argument("Unknown pinning: " + name);
+}
+
+/**
+ * Returns the number of NUMA nodes that have CPUs this process is
+ * allowed to run on.
+ *
+ * \return The number of nodes, which is at least 1.
+ */
+size_t nodeCount();
+
+/**
+ * Returns the number of CPUs this process is allowed to run on (for
+ * example, the CPUs allocated to a job by the batch scheduler), which
+ * may be fewer than std::thread::hardware_concurrency.
+ *
+ * \return The number of CPUs, which is at least 1.
+ */
+size_t cpuCount();
+
+/**
+ * Returns the node (numbered 0 to nodeCount() - 1) of a given CPU.
+ *
+ * \param[in] cpu The ID of the CPU (as used by the operating system).
+ *
+ * \return The node of the CPU, or 0 if the CPU is not known.
+ */
+size_t nodeOfCpu(const int cpu);
+
+/**
+ * Returns the CPUs this process is allowed to run on, in the order in
+ * which threads are pinned to them for a given pinning.  With compact
+ * pinning the CPUs of node 0 come first, then those of node 1, and so
+ * on.  With scatter pinning consecutive CPUs are on different nodes.
+ *
+ * \param[in] pinning The pinning to be used.
+ *
+ * \return The CPUs to pin threads to, which is empty for
+ * Pinning::None.
+ */
+std::vector<int> cpuOrder(const Pinning pinning);
+
+/**
+ * Pins the calling thread to a given CPU.  The thread is then treated
+ * as being on the node of that CPU by currentNode.
+ *
+ * \param[in] cpu The ID of the CPU to run the calling thread on.
+ *
+ * \return True if the thread was pinned.
+ */
+bool pinThread(const int cpu);
+
+/**
+ * Returns the node of the calling thread.  Pinned threads (see
+ * pinThread) stay on their node, which is remembered.  Threads that
+ * have not been pinned can move between nodes, so their node is looked
+ * up on every call and is only a hint for them.
+ *
+ * \return The node (numbered 0 to nodeCount() - 1) of the thread.
+ */
+size_t currentNode();
+
+/**
+ * A copy of some read-mostly data (for example, a network being
+ * assessed or the pixels of a dataset) on each NUMA node other than
+ * that of the thread creating the copies, which uses the original
+ * data.  For example:
+ *
+ * \code
+ * Numa::Replicated<NeuralNet> replicas;
+ * replicas.assign(pool, net);
+ * pool.run([&](const size_t tid) {
+ *     const NeuralNet* local = replicas.local();
+ *     classify((local != nullptr) ? *local : net, tid);
+ * });
+ * \endcode
+ *
+ * \tparam T The type of the copies, which must be movable.
+ */
+template<typename T>
+class Replicated {
+public:
+    /** Creates an empty set of copies (i.e., just the original) */
+    Replicated() = default;
+
+    /**
+     * Creates the copies for the nodes on which the threads of a
+     * given pool run.  The copy for a node is created by the first
+     * thread of the pool on that node, so that its memory is first
+     * touched there.  Nothing is copied if there is only one node.
+     *
+     * \param[in] pool The threads that will use the copies.  They
+     * should be pinned (see Pinning) to keep them on their nodes.
+     *
+     * \param[in] make The callable that returns a new copy of the
+     * data.  It is called concurrently from multiple threads.
+     */
+    template<typename MakeFn>
+    void build(ThreadPool& pool, const MakeFn& make) {
+        forEachNode(pool, [&](std::unique_ptr<T>& copy) {
+            copy = std::make_unique<T>(make()); });
+    }
+
+    /**
+     * Sets the copies for the nodes on which the threads of a given
+     * pool run to a given value (as done by build).  Existing copies
+     * are assigned, so that their memory is reused (for example, when
+     * the network being assessed is updated in every epoch).
+     *
+     * \param[in] pool The threads that will use the copies.
+     *
+     * \param[in] value The value of the original data.
+     */
+    void assign(ThreadPool& pool, const T& value) {
+        forEachNode(pool, [&](std::unique_ptr<T>& copy) {
+            if (copy != nullptr) {
+                *copy = value;
+            } else {
+                copy = std::make_unique<T>(value);
+            }
+        });
+    }
+
+    /**
+     * Returns the copy for the node of the calling thread.
+     *
+     * \return The copy, or nullptr if the original data should be
+     * used instead (for example, on the node that created the copies).
+     */
+    const T* local() const {
+        if (copies.empty()) {
+            return nullptr;  // Nothing was replicated.
+        }
+        const size_t node = currentNode();
+        return (node < copies.size()) ? copies[node].get() : nullptr;
+    }
+
+private:
+    /**
+     * Calls a given function (with the copy to be set) once for each
+     * node other than that of the calling thread, from the first
+     * thread of a pool on that node.
+     */
+    template<typename SetFn>
+    void forEachNode(ThreadPool& pool, const SetFn& set) {
+        const size_t nodes = nodeCount();
+        if (nodes < 2 || pool.size() < 2) {
+            return;
+        }
+        const size_t home = currentNode();
+        copies.resize(nodes);
+        std::unique_ptr<std::once_flag[]> flags(new std::once_flag[nodes]);
+        // Each thread writes only the copy for its own node.
+        pool.run([&](const size_t) {
+            const size_t node = currentNode();
+            if (node != home) {
+                std::call_once(flags[node], [&] { set(copies[node]); });
+            }
+        });
+    }
+
+    /** The copy for each node, which is null for the home node */
+    std::vector<std::unique_ptr<T>> copies;
+};
+
+}  // namespace Numa
+
+#endif
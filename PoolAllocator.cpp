@@ -0,0 +1,132 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef POOL_ALLOCATOR_CPP
+#define POOL_ALLOCATOR_CPP
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include "PoolAllocator.h"
+
+namespace {
+
+/** The smallest size class is one cache line (2^6 bytes) */
+constexpr size_t MinClassBits = 6;
+
+/** The number of bytes that may be kept in the pool for each class */
+constexpr size_t MaxCachedBytes = size_t(16) << 20;
+
+/**
+ * Blocks larger than 2^24 bytes (16 MiB) are not pooled, as the pool
+ * could not keep even one of them
+ */
+constexpr size_t MaxClassBits = 24;
+
+static_assert((size_t(1) << MaxClassBits) == MaxCachedBytes,
+              "The largest class must fit in the bytes kept per class");
+
+/** The blocks held in the pool are chained via their first bytes */
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+/** The blocks of one size class held in the pool */
+struct SizeClass {
+    std::mutex mutex;
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+};
+
+/** The running totals reported by MemoryPool::stats */
+std::atomic<size_t> allocationCount{0};
+std::atomic<size_t> heapAllocationCount{0};
+std::atomic<size_t> allocatedBytes{0};
+
+// Returns the size classes.  These are intentionally never destroyed,
+// so that static matrices can still be freed when the program exits.
+SizeClass* sizeClasses() {
+    static SizeClass* classes = new SizeClass[MaxClassBits + 1];
+    return classes;
+}
+
+// Returns the size class (the log2 of the block size) for a request.
+size_t classOf(const size_t bytes) {
+    size_t bits = MinClassBits;
+    while ((size_t(1) << bits) < bytes) {
+        bits++;
+    }
+    return bits;
+}
+
+// Allocates a new aligned block from the heap.
+void* allocateBlock(const size_t bytes) {
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::aligned_alloc(MemoryPool::Alignment, bytes);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+}  // namespace
+
+void* MemoryPool::allocate(const size_t bytes) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    const size_t bits = classOf(bytes);
+    if (bits > MaxClassBits) {
+        // Round up to the alignment as required by aligned_alloc.
+        return allocateBlock((bytes + Alignment - 1) / Alignment * Alignment);
+    }
+    SizeClass& sc = sizeClasses()[bits];
+    {
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        if (FreeBlock* block = sc.head) {
+            sc.head = block->next;
+            sc.count--;
+            return block;
+        }
+    }
+    return allocateBlock(size_t(1) << bits);
+}
+
+void MemoryPool::deallocate(void* ptr, const size_t bytes) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    const size_t bits = classOf(bytes);
+    if (bits <= MaxClassBits) {
+        // Keep the block in the pool, unless the class would then
+        // hold more than MaxCachedBytes.
+        SizeClass& sc = sizeClasses()[bits];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        if (((sc.count + 1) << bits) <= MaxCachedBytes) {
+            FreeBlock* block = static_cast<FreeBlock*>(ptr);
+            block->next = sc.head;
+            sc.head = block;
+            sc.count++;
+            return;
+        }
+    }
+    std::free(ptr);
+}
+
+void MemoryPool::trim() noexcept {
+    for (size_t bits = MinClassBits; (bits <= MaxClassBits); bits++) {
+        SizeClass& sc = sizeClasses()[bits];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        while (FreeBlock* block = sc.head) {
+            sc.head = block->next;
+            std::free(block);
+        }
+        sc.count = 0;
+    }
+}
+
+MemoryPool::Stats MemoryPool::stats() noexcept {
+    return {allocationCount.load(std::memory_order_relaxed),
+            heapAllocationCount.load(std::memory_order_relaxed),
+            allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+#endif
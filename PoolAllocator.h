@@ -0,0 +1,133 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+/** \file PoolAllocator.h An aligned, pooled allocator for Matrix.
+
+    This file contains a standard-library compatible allocator that
+    hands out 64-byte (cache line and AVX-512 register) aligned blocks
+    from a pool of power-of-two size classes.  Freed blocks are kept
+    in the pool and reused.  So steady-state training and inference,
+    which repeatedly create temporaries of the same sizes, do not call
+    malloc.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/** The functions that manage the pool of blocks used by PoolAllocator */
+namespace MemoryPool {
+
+/** The alignment (in bytes) of all blocks returned by allocate */
+constexpr size_t Alignment = 64;
+
+/**
+ * Returns a block with at least the given number of bytes, reusing
+ * a block from the pool whenever possible.  This function is
+ * thread-safe.  An exception (std::bad_alloc) is thrown if memory
+ * cannot be allocated.
+ *
+ * \param[in] bytes The number of bytes needed.
+ *
+ * \return A block aligned to Alignment bytes.
+ */
+void* allocate(const size_t bytes);
+
+/**
+ * Returns a block obtained from allocate to the pool.  This function
+ * is thread-safe and the block need not be returned by the thread
+ * that allocated it.
+ *
+ * \param[in] ptr The block to be returned.
+ *
+ * \param[in] bytes The number of bytes used in the call to allocate.
+ */
+void deallocate(void* ptr, const size_t bytes) noexcept;
+
+/**
+ * Frees all the blocks currently held in the pool (but not the
+ * blocks in use).  This can be used to release memory between
+ * experiments.
+ */
+void trim() noexcept;
+
+/** Running totals of the blocks handed out by the pool */
+struct Stats {
+    /** The number of calls to allocate */
+    size_t allocations;
+    /** The number of those calls that had to allocate from the heap */
+    size_t heapAllocations;
+    /** The number of bytes requested by the calls to allocate */
+    size_t bytes;
+};
+
+/**
+ * Returns the number of allocations made so far (by all threads).
+ * The benchmarks use the difference between two calls to report the
+ * allocations made by an operation.
+ *
+ * \return The running totals of the allocations.
+ */
+Stats stats() noexcept;
+
+}  // namespace MemoryPool
+
+/**
+ * An allocator that uses the MemoryPool.  In addition, the values are
+ * default-initialized rather than value-initialized when a container
+ * is resized.  That is, std::vector<Val, PoolAllocator<Val>>::resize
+ * does not zero the new values (which are usually overwritten right
+ * away).  Values that are explicitly passed to the container (for
+ * example, std::vector(n, 0)) are used as usual.
+ */
+template<typename T>
+class PoolAllocator {
+public:
+    /** The type of values allocated (required by the standard) */
+    using value_type = T;
+
+    /** All instances use the same pool and are interchangeable */
+    using is_always_equal = std::true_type;
+
+    PoolAllocator() noexcept = default;
+
+    /** Conversion from an allocator for another type */
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    /** Allocates space for n values */
+    T* allocate(const size_t n) {
+        return static_cast<T*>(MemoryPool::allocate(n * sizeof(T)));
+    }
+
+    /** Returns the space for n values to the pool */
+    void deallocate(T* ptr, const size_t n) noexcept {
+        MemoryPool::deallocate(ptr, n * sizeof(T));
+    }
+
+    /** Default-initializes (i.e., does not zero) a value */
+    template<typename U>
+    void construct(U* ptr) noexcept(
+        std::is_nothrow_default_constructible<U>::value) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    /** Constructs a value from the given arguments */
+    template<typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    /** Allocators for all types share the same pool */
+    template<typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+
+    /** Allocators for all types share the same pool */
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef PROFILER_CPP
+#define PROFILER_CPP
+
+#include <atomic>
+#include <iomanip>
+#include "PoolAllocator.h"
+#include "Profiler.h"
+
+namespace {
+
+/** The total time and number of calls of one phase */
+struct alignas(64) PhaseTotals {
+    std::atomic<uint64_t> ns{0};
+    std::atomic<uint64_t> calls{0};
+};
+
+/** One counter (on its own cache line to avoid false sharing) */
+struct alignas(64) CounterTotal {
+    std::atomic<uint64_t> count{0};
+};
+
+PhaseTotals phases[Profiler::PhaseCount];
+CounterTotal counters[Profiler::CounterCount];
+
+/** The allocations made before the last call to reset */
+MemoryPool::Stats baseline = MemoryPool::stats();
+
+/** The names of the phases in the JSON output */
+const char* const PhaseNames[Profiler::PhaseCount] = {
+    "train", "forward", "backward", "update", "fetch", "assess"};
+
+// Returns the value of a given counter.
+uint64_t counter(const Profiler::Counter counter) {
+    return counters[size_t(counter)].count.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+void Profiler::addTime(const Phase phase, const uint64_t ns) noexcept {
+    PhaseTotals& totals = phases[size_t(phase)];
+    totals.ns.fetch_add(ns, std::memory_order_relaxed);
+    totals.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::add(const Counter counter, const uint64_t count) noexcept {
+    counters[size_t(counter)].count.fetch_add(count,
+                                              std::memory_order_relaxed);
+}
+
+void Profiler::reset() noexcept {
+    for (PhaseTotals& totals : phases) {
+        totals.ns.store(0, std::memory_order_relaxed);
+        totals.calls.store(0, std::memory_order_relaxed);
+    }
+    for (CounterTotal& total : counters) {
+        total.count.store(0, std::memory_order_relaxed);
+    }
+    baseline = MemoryPool::stats();
+}
+
+void Profiler::writeJson(std::ostream& os, const int epoch) {
+    // The formatting is restored at the end, so that later output by
+    // the caller (for example, the accuracy) is not affected.
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << "{\"epoch\": " << epoch << std::fixed << std::setprecision(3);
+    for (size_t i = 0; (i < PhaseCount); i++) {
+        os << ", \"" << PhaseNames[i] << "_ms\": "
+           << phases[i].ns.load(std::memory_order_relaxed) * 1e-6
+           << ", \"" << PhaseNames[i] << "_calls\": "
+           << phases[i].calls.load(std::memory_order_relaxed);
+    }
+    // The samples per second are over the time spent training.
+    const uint64_t samples = counter(Counter::Samples);
+    const uint64_t trainNs =
+        phases[size_t(Phase::Train)].ns.load(std::memory_order_relaxed);
+    const uint64_t lookups = counter(Counter::CacheLookups);
+    const uint64_t misses  = counter(Counter::CacheMisses);
+    const MemoryPool::Stats now = MemoryPool::stats();
+    os << std::setprecision(1) << ", \"samples\": " << samples
+       << ", \"samples_per_sec\": "
+       << ((trainNs > 0) ? samples * 1e9 / trainNs : 0.0)
+       << ", \"cache_hits\": " << (lookups - misses)
+       << ", \"cache_misses\": " << misses
+       << ", \"allocations\": " << (now.allocations - baseline.allocations)
+       << ", \"heap_allocations\": "
+       << (now.heapAllocations - baseline.heapAllocations)
+       << ", \"bytes_allocated\": " << (now.bytes - baseline.bytes)
+       << "}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+    reset();
+}
+
+#endif
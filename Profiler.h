@@ -0,0 +1,145 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/** \file Profiler.h Low-overhead timers and counters for the hot paths.
+
+    This file contains the instrumentation used to attribute the time
+    of each epoch to its phases (forward pass, backward pass, weight
+    updates, fetching images, and assessment) and to count the image
+    cache hits and misses and the samples trained.  The totals are
+    written as one JSON line per epoch (see writeJson), along with the
+    memory allocated via the MemoryPool.
+
+    The instrumentation is compiled in only if the program is compiled
+    with -DNNET_PROFILE.  Otherwise, the NNET_PROFILE_SCOPE and
+    NNET_PROFILE_COUNT macros used in the hot paths expand to nothing,
+    so there is no overhead at all.  For example:
+
+    \code
+    void NeuralNet::update(const Workspace& ws, const Val rate) {
+        NNET_PROFILE_SCOPE(Profiler::Phase::Update);
+        // ...
+    }
+    \endcode
+
+    The totals are kept in relaxed atomics, so the macros may be used
+    from any thread (such as the threads of a ThreadPool or the
+    background threads of a BatchLoader).
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/** The timers and counters for the hot paths */
+namespace Profiler {
+
+/** True if the instrumentation is compiled in (via -DNNET_PROFILE) */
+#ifdef NNET_PROFILE
+constexpr bool Enabled = true;
+#else
+constexpr bool Enabled = false;
+#endif
+
+/** The phases whose times are accumulated */
+enum class Phase { Train, Forward, Backward, Update, Fetch, Assess };
+
+/** The number of phases */
+constexpr size_t PhaseCount = 6;
+
+/** The events that are counted */
+enum class Counter { Samples, CacheLookups, CacheMisses };
+
+/** The number of counters */
+constexpr size_t CounterCount = 3;
+
+/**
+ * Adds the time spent in one call to a given phase.  This function is
+ * thread-safe.
+ *
+ * \param[in] phase The phase to which the time is added.
+ *
+ * \param[in] ns The time spent in nanoseconds.
+ */
+void addTime(const Phase phase, const uint64_t ns) noexcept;
+
+/**
+ * Adds to a given counter.  This function is thread-safe.
+ *
+ * \param[in] counter The counter to be incremented.
+ *
+ * \param[in] count The number of events.
+ */
+void add(const Counter counter, const uint64_t count = 1) noexcept;
+
+/**
+ * Clears all the times and counters and starts measuring the memory
+ * allocated via the MemoryPool from this point.
+ */
+void reset() noexcept;
+
+/**
+ * Writes the times and counters accumulated since the last call to
+ * reset as a single JSON line and then resets them.  The samples per
+ * second are based on the time of the Train phase.
+ *
+ * \param[out] os The output stream to which the line is written.
+ *
+ * \param[in] epoch The epoch reported in the line.
+ */
+void writeJson(std::ostream& os, const int epoch);
+
+/**
+ * A timer that adds the time from its creation to its destruction to
+ * a given phase.  Use it via NNET_PROFILE_SCOPE so that it is
+ * compiled out when profiling is disabled.
+ */
+class ScopedTimer {
+public:
+    /**
+     * Starts timing a given phase.
+     *
+     * \param[in] phase The phase to which the time is added.
+     */
+    explicit ScopedTimer(const Phase phase) :
+        phase(phase), start(Clock::now()) {}
+
+    /** Adds the time since the constructor to the phase */
+    ~ScopedTimer() {
+        using namespace std::literals;
+        addTime(phase, (Clock::now() - start) / 1ns);
+    }
+
+    // A timer measures only the scope in which it is created.
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /** The phase being timed */
+    const Phase phase;
+
+    /** The time at which the timer was created */
+    const Clock::time_point start;
+};
+
+}  // namespace Profiler
+
+#ifdef NNET_PROFILE
+#define NNET_PROFILE_JOIN2(a, b) a##b
+#define NNET_PROFILE_JOIN(a, b) NNET_PROFILE_JOIN2(a, b)
+/** Times the rest of the enclosing scope as a given Profiler::Phase */
+#define NNET_PROFILE_SCOPE(phase) \
+    const Profiler::ScopedTimer NNET_PROFILE_JOIN(profileTimer, __LINE__)(phase)
+/** Adds a given count to a given Profiler::Counter */
+#define NNET_PROFILE_COUNT(counter, count) Profiler::add(counter, count)
+#else
+#define NNET_PROFILE_SCOPE(phase) ((void)0)
+#define NNET_PROFILE_COUNT(counter, count) ((void)0)
+#endif
+
+#endif
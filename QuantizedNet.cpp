@@ -0,0 +1,134 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef QUANTIZED_NET_CPP
+#define QUANTIZED_NET_CPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include "QuantizedNet.h"
+#include "MatrixKernels.h"
+
+// Activations in the range 0 to 1.0 are quantized in 1/255 steps.
+static constexpr Val ActScale = 255;
+
+// The largest magnitude of a quantized bias.  It leaves room for the
+// inner products (at most 255 * 127 per input) in an int32.
+static constexpr int32_t MaxBias = 1 << 30;
+
+// Helper method to quantize an activation in the range 0 to 1.0.
+static uint8_t quantize(const Val act) {
+    return std::lround(std::min(std::max(act, Val(0)), Val(1)) * ActScale);
+}
+
+bool QuantizedNet::isSupported(const NeuralNet& net) {
+    const auto& acts = net.layerActivations;
+    return std::all_of(acts.begin(), acts.end() - (acts.empty() ? 0 : 1),
+                       [](const Activation act) {
+                           return act == Activation::Sigmoid; });
+}
+
+QuantizedNet::QuantizedNet(const NeuralNet& net) {
+    if (!isSupported(net)) {
+        throw std::invalid_argument("Only sigmoid hidden layers can be "
+                                    "quantized");
+    }
+    for (size_t lyr = 0; (lyr < net.weights.size()); lyr++) {
+        const Matrix& w = net.weights[lyr];
+        Layer layer{w.rows, w.cols, std::vector<int8_t>(w.rows * w.cols),
+                    std::vector<Val>(w.rows), std::vector<int32_t>(w.rows)};
+        for (size_t row = 0; (row < w.rows); row++) {
+            const Val* vals = &w.data[row * w.cols];
+            Val maxAbs = 0;
+            for (size_t col = 0; (col < w.cols); col++) {
+                maxAbs = std::max(maxAbs, std::abs(vals[col]));
+            }
+            // The weight represented by an int8 value of 1.
+            const Val step = (maxAbs > 0) ? maxAbs / 127 : 1;
+            for (size_t col = 0; (col < w.cols); col++) {
+                layer.weights[row * w.cols + col] = std::lround(vals[col] /
+                                                                step);
+            }
+            // The integer sums are in units of step / ActScale.
+            layer.scales[row] = step / ActScale;
+            // Clamp the biases of rows with tiny weights so that the
+            // sums cannot overflow.
+            const Val bias = net.biases[lyr].data[row] / layer.scales[row];
+            layer.biases[row] = std::lround(std::min(std::max(bias,
+                                                     Val(-MaxBias)),
+                                            Val(MaxBias)));
+        }
+        layers.push_back(std::move(layer));
+    }
+}
+
+int QuantizedNet::classify(const uint8_t* input) const {
+    assert(!layers.empty());
+    size_t maxSize = 0;
+    for (const auto& layer : layers) {
+        maxSize = std::max(maxSize, layer.rows);
+    }
+    // Per-thread scratch buffers for the quantized activations and
+    // the weighted inputs of each layer.
+    thread_local std::vector<uint8_t> acts;
+    thread_local std::vector<Val> zs;
+    if (zs.size() < maxSize) {
+        acts.resize(maxSize);
+        zs.resize(maxSize);
+    }
+    const MatrixKernels& kernels = matrixKernels();
+    const uint8_t* in = input;
+    for (const auto& layer : layers) {
+        for (size_t row = 0; (row < layer.rows); row++) {
+            const int32_t sum = layer.biases[row] +
+                kernels.dotU8S8(in, &layer.weights[row * layer.cols],
+                                layer.cols);
+            zs[row] = sum * layer.scales[row];
+        }
+        if (&layer == &layers.back()) {
+            break;  // The sigmoid does not change the largest output.
+        }
+        kernels.sigmoid(zs.data(), zs.data(), layer.rows);
+        for (size_t row = 0; (row < layer.rows); row++) {
+            acts[row] = quantize(zs[row]);
+        }
+        in = acts.data();
+    }
+    const size_t outputs = layers.back().rows;
+    return std::max_element(zs.begin(), zs.begin() + outputs) - zs.begin();
+}
+
+int QuantizedNet::predict(const float* pixels) const {
+    thread_local std::vector<uint8_t> input;
+    input.resize(layers.front().cols);
+    for (size_t i = 0; (i < input.size()); i++) {
+        input[i] = quantize(pixels[i]);
+    }
+    return classify(input.data());
+}
+
+std::vector<int> QuantizedNet::classifyBatch(const Matrix& inputs) const {
+    assert(inputs.rows == layers.front().cols);
+    std::vector<int> labels(inputs.cols);
+    std::vector<uint8_t> input(inputs.rows);
+    for (size_t col = 0; (col < inputs.cols); col++) {
+        for (size_t row = 0; (row < inputs.rows); row++) {
+            input[row] = quantize(inputs.data[row * inputs.cols + col]);
+        }
+        labels[col] = classify(input.data());
+    }
+    return labels;
+}
+
+size_t QuantizedNet::sizeInBytes() const {
+    size_t bytes = 0;
+    for (const auto& layer : layers) {
+        bytes += layer.weights.size() * sizeof(int8_t) +
+            layer.scales.size() * sizeof(Val) +
+            layer.biases.size() * sizeof(int32_t);
+    }
+    return bytes;
+}
+
+#endif
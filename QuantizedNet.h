@@ -0,0 +1,128 @@
+#ifndef QUANTIZED_NET_H
+#define QUANTIZED_NET_H
+
+/** \file QuantizedNet.h An int8 quantized version of a NeuralNet.
+
+    This file contains an inference-only version of a trained
+    NeuralNet in which the weights are stored as 8-bit integers.  The
+    model is 4x (8x with doubles) smaller than the original so that it
+    fits in the L1/L2 caches of each core, and the forward pass uses
+    integer inner products (VNNI instructions where available).
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <cstdint>
+#include <vector>
+#include "Matrix.h"
+#include "NeuralNet.h"
+
+/**
+ * An int8 quantized copy of a NeuralNet for fast classification.  The
+ * quantization is symmetric with a scale per row (neuron):
+ *
+ * <ul>
+ * <li>Each row of weights is scaled so that its largest magnitude
+ * maps to 127 and is rounded to int8.</li>
+ *
+ * <li>The activations (pixels and sigmoid outputs), which are in the
+ * range 0 to 1.0, are rounded to uint8 values in 1/255 steps.  The
+ * pixels in PGM and packed datasets are bytes, so the inputs are
+ * quantized without any loss.</li>
+ *
+ * <li>The biases are rounded to int32 values in the units of the
+ * integer inner products, so they are just added to the sums.</li>
+ * </ul>
+ *
+ * The network cannot be modified once created.  So it can be used
+ * concurrently from multiple threads.
+ */
+class QuantizedNet {
+public:
+    /**
+     * Quantizes the weights and biases of a given network.
+     *
+     * \param[in] net The trained network to be quantized.  An
+     * exception is thrown if the network is not supported.
+     */
+    explicit QuantizedNet(const NeuralNet& net);
+
+    /**
+     * Checks whether a given network can be quantized.  Since the
+     * activations are quantized to the range 0 to 1.0, all the hidden
+     * layers must use the sigmoid.  The output layer can use any
+     * activation function as they all preserve the largest output.
+     *
+     * \param[in] net The network to be checked.
+     *
+     * \return Returns true if the network can be quantized.
+     */
+    static bool isSupported(const NeuralNet& net);
+
+    /**
+     * Classifies a single image, similar to NeuralNet::predict.  This
+     * method runs on scratch buffers owned by the calling thread and
+     * does not allocate memory after the first call in each thread.
+     *
+     * \param[in] pixels The normalized pixels (0 to 1.0) of the
+     * image.
+     *
+     * \return The index of the output neuron with the highest
+     * activation (i.e., the digit).
+     */
+    int predict(const float* pixels) const;
+
+    /**
+     * Classifies a batch of images, similar to
+     * NeuralNet::classifyBatch.
+     *
+     * \param[in] inputs The input images, one image per column.
+     *
+     * \return The index of the maximum output for each image.
+     */
+    std::vector<int> classifyBatch(const Matrix& inputs) const;
+
+    /**
+     * Returns the number of bytes used by the quantized weights,
+     * scales, and biases.
+     *
+     * \return The size of the model in bytes.
+     */
+    size_t sizeInBytes() const;
+
+private:
+    /** The quantized weights and biases of one layer */
+    struct Layer {
+        /** The number of neurons in this layer */
+        size_t rows;
+
+        /** The number of neurons in the previous layer */
+        size_t cols;
+
+        /** The row-major int8 weights */
+        std::vector<int8_t> weights;
+
+        /** The scale to convert the integer sums of each row to Val */
+        std::vector<Val> scales;
+
+        /** The biases in the same units as the integer sums */
+        std::vector<int32_t> biases;
+    };
+
+    /**
+     * The forward pass for a single image, given as quantized
+     * activations.  The pass ping-pongs between scratch buffers owned
+     * by the calling thread.
+     *
+     * \param[in] input The quantized pixels of the image.
+     *
+     * \return The index of the output neuron with the highest
+     * activation.
+     */
+    int classify(const uint8_t* input) const;
+
+    /** The quantized layers of the network */
+    std::vector<Layer> layers;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef SPARSE_VECTOR_H
+#define SPARSE_VECTOR_H
+
+/** \file SparseVector.h A sparse (index/value) form of images.
+
+    This file contains the compressed forms of an input image and of a
+    batch of images in which only the non-zero pixels are stored.
+    About 80% of the pixels of a handwritten digit are zero (the
+    background), so the first layer of a network can skip most of its
+    work for such inputs (see FixedNeuralNet and
+    NeuralNet::setSparseInputs).
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Matrix.h"
+
+/**
+ * A vector in which only the non-zero values are stored, along with
+ * their indexes (in increasing order).  The storage is reused when a
+ * vector is reassigned, so that converting every image of a dataset
+ * does not allocate memory after the first image.
+ */
+struct SparseVector {
+    /** The number of values in the dense form of this vector */
+    size_t size = 0;
+
+    /** The index of each non-zero value */
+    std::vector<uint32_t> indices;
+
+    /** The non-zero values */
+    std::vector<Val> values;
+
+    /**
+     * Returns the number of non-zero values.
+     *
+     * \return The number of non-zero values.
+     */
+    size_t nonZeros() const { return indices.size(); }
+
+    /**
+     * Sets this vector from the dense form of a vector.
+     *
+     * \param[in] dense The values of the vector.
+     *
+     * \param[in] n The number of values.
+     */
+    void assign(const Val* dense, const size_t n) {
+        clear(n);
+        for (size_t i = 0; (i < n); i++) {
+            if (dense[i] != 0) {
+                indices.push_back(i);
+                values.push_back(dense[i]);
+            }
+        }
+    }
+
+    /**
+     * Sets this vector from bytes (such as pixels 0 to 255) that are
+     * divided by a given value.
+     *
+     * \param[in] bytes The values of the vector as bytes.
+     *
+     * \param[in] n The number of values.
+     *
+     * \param[in] divisor The value by which each byte is divided (for
+     * example, 255 to normalize pixels as done by loadPGM).
+     */
+    void assign(const uint8_t* bytes, const size_t n, const Val divisor) {
+        clear(n);
+        for (size_t i = 0; (i < n); i++) {
+            if (bytes[i] != 0) {
+                indices.push_back(i);
+                values.push_back(bytes[i] / divisor);
+            }
+        }
+    }
+
+private:
+    // Empties this vector (keeping its storage) and sets its size.
+    void clear(const size_t n) {
+        size = n;
+        indices.clear();
+        values.clear();
+        indices.reserve(n);
+        values.reserve(n);
+    }
+};
+
+/**
+ * A batch of images (one image per column, as in the batches used by
+ * NeuralNet) in which only the non-zero values are stored.  The
+ * non-zero values of each column (i.e., of each image) are stored
+ * together, in the same form as a SparseVector.  Like SparseVector,
+ * the storage is reused when a matrix is reassigned.
+ */
+struct SparseMatrix {
+    /** The number of rows in the dense form of this matrix */
+    size_t rows = 0;
+
+    /** The number of columns in the dense form of this matrix */
+    size_t cols = 0;
+
+    /**
+     * The offset of the first non-zero value of each column in
+     * rowIndices and values, followed by the number of non-zero
+     * values.
+     */
+    std::vector<uint32_t> colStarts;
+
+    /** The row of each non-zero value */
+    std::vector<uint32_t> rowIndices;
+
+    /** The non-zero values */
+    std::vector<Val> values;
+
+    /**
+     * Returns the number of non-zero values.
+     *
+     * \return The number of non-zero values.
+     */
+    size_t nonZeros() const { return values.size(); }
+
+    /**
+     * Sets this matrix from the dense form of a matrix.  Each column
+     * is first gathered into a scratch buffer without any branches,
+     * as whether a pixel is zero is hard to predict.
+     *
+     * \param[in] dense The matrix to be converted.
+     */
+    void assign(const Matrix& dense) {
+        rows = dense.rows;
+        cols = dense.cols;
+        colStarts.resize(cols + 1);
+        rowIndices.resize(rows);
+        values.resize(rows);
+        size_t count = 0;
+        for (size_t col = 0; (col < cols); col++) {
+            colStarts[col] = count;
+            // Keep room for a whole column after the values so far.
+            rowIndices.resize(std::max(rowIndices.size(), count + rows));
+            values.resize(rowIndices.size());
+            for (size_t row = 0; (row < rows); row++) {
+                const Val val = dense.data[row * cols + col];
+                rowIndices[count] = row;
+                values[count] = val;
+                count += (val != 0);
+            }
+        }
+        colStarts[cols] = count;
+        rowIndices.resize(count);
+        values.resize(count);
+    }
+
+    /**
+     * Fused form of lhs . this + bias (as in Matrix::dotAddBias, with
+     * this matrix as the right-hand operand).  Each value of the
+     * result is an inner product of a row of lhs with the non-zero
+     * values of a column of this matrix, which reads only the values
+     * of lhs for the non-zero values.
+     *
+     * \param[in] lhs The matrix to be multiplied.  This matrix must
+     * have the same number of columns as the rows of this matrix.
+     *
+     * \param[in] bias A column-vector with the same number of rows as
+     * lhs, which is added to each column of the product.
+     *
+     * \param[out] result The matrix to be resized (if needed) to
+     * lhs.rows x cols and set to the product plus bias.
+     */
+    void leftDotAddBias(const Matrix& lhs, const Matrix& bias,
+                        Matrix& result) const {
+        assert(lhs.cols == rows && bias.rows == lhs.rows);
+        result.resize(lhs.rows, cols);
+        for (size_t col = 0; (col < cols); col++) {
+            const uint32_t* idx = &rowIndices[colStarts[col]];
+            const Val* vals = &values[colStarts[col]];
+            const size_t count = colStarts[col + 1] - colStarts[col];
+            // Four rows at a time, so that the sums are independent
+            // (rather than one long chain of dependent additions).
+            size_t row = 0;
+            for (; (row + 4 <= lhs.rows); row += 4) {
+                const Val* lhsRow = &lhs.data[row * lhs.cols];
+                const size_t ld = lhs.cols;
+                Val sum0 = bias.data[row],     sum1 = bias.data[row + 1];
+                Val sum2 = bias.data[row + 2], sum3 = bias.data[row + 3];
+                for (size_t i = 0; (i < count); i++) {
+                    sum0 += lhsRow[idx[i]]          * vals[i];
+                    sum1 += lhsRow[idx[i] + ld]     * vals[i];
+                    sum2 += lhsRow[idx[i] + 2 * ld] * vals[i];
+                    sum3 += lhsRow[idx[i] + 3 * ld] * vals[i];
+                }
+                result.data[row * cols + col]       = sum0;
+                result.data[(row + 1) * cols + col] = sum1;
+                result.data[(row + 2) * cols + col] = sum2;
+                result.data[(row + 3) * cols + col] = sum3;
+            }
+            for (; (row < lhs.rows); row++) {
+                const Val* lhsRow = &lhs.data[row * lhs.cols];
+                Val sum = bias.data[row];
+                for (size_t i = 0; (i < count); i++) {
+                    sum += lhsRow[idx[i]] * vals[i];
+                }
+                result.data[row * cols + col] = sum;
+            }
+        }
+    }
+
+    /**
+     * Computes lhs . transpose(this) (as in Matrix::dotNT, with this
+     * matrix as the right-hand operand).  The non-zero values of each
+     * column of this matrix, scaled by the corresponding column of
+     * lhs, are added to the values of the result for their rows.  The
+     * other values of the result are just set to zero.
+     *
+     * \param[in] lhs The matrix to be multiplied.  This matrix must
+     * have the same number of columns as this matrix.
+     *
+     * \param[out] result The matrix to be resized (if needed) to
+     * lhs.rows x rows and set to the product.
+     */
+    void leftDotNT(const Matrix& lhs, Matrix& result) const {
+        assert(lhs.cols == cols);
+        result.resize(lhs.rows, rows);
+        std::fill(result.data.begin(), result.data.end(), Val(0));
+        for (size_t col = 0; (col < cols); col++) {
+            const uint32_t* idx = &rowIndices[colStarts[col]];
+            const Val* vals = &values[colStarts[col]];
+            const size_t count = colStarts[col + 1] - colStarts[col];
+            // Four rows at a time, to load each index and value once.
+            size_t row = 0;
+            for (; (row + 4 <= lhs.rows); row += 4) {
+                const Val* scale = &lhs.data[row * lhs.cols + col];
+                const size_t ld = lhs.cols;
+                Val* out = &result.data[row * rows];
+                for (size_t i = 0; (i < count); i++) {
+                    const size_t pos = idx[i];
+                    const Val val = vals[i];
+                    out[pos]            += scale[0]      * val;
+                    out[pos + rows]     += scale[ld]     * val;
+                    out[pos + 2 * rows] += scale[2 * ld] * val;
+                    out[pos + 3 * rows] += scale[3 * ld] * val;
+                }
+            }
+            for (; (row < lhs.rows); row++) {
+                const Val scale = lhs.data[row * lhs.cols + col];
+                Val* out = &result.data[row * rows];
+                for (size_t i = 0; (i < count); i++) {
+                    out[idx[i]] += scale * vals[i];
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright (C) 2025 acharyp@miamioh.edu
+
+#ifndef THREAD_POOL_CPP
+#define THREAD_POOL_CPP
+
+#include "Numa.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(const size_t threads, const std::vector<int>& cpus) {
+    // The calling thread is thread 0, so create one fewer thread.
+    for (size_t id = 1; (id < threads); id++) {
+        const int cpu = cpus.empty() ? -1 : cpus[(id - 1) % cpus.size()];
+        workers.emplace_back(&ThreadPool::workerLoop, this, id, cpu);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    taskReady.notify_all();
+    for (auto& thr : workers) {
+        thr.join();
+    }
+}
+
+void ThreadPool::run(const Task& task) {
+    if (workers.empty()) {
+        task(0);  // Nothing to coordinate with just 1 thread.
+        return;
+    }
+    // Publish the task to the workers.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        pending = workers.size();
+        error = nullptr;
+        generation++;
+    }
+    taskReady.notify_all();
+    // The calling thread does its share of the work as thread 0.
+    runTask(task, 0);
+    // Wait for all of the workers to finish.
+    std::unique_lock<std::mutex> lock(mutex);
+    taskDone.wait(lock, [this] { return pending == 0; });
+    this->task = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::runTask(const Task& task, const size_t id) {
+    try {
+        task(id);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(const size_t id, const int cpu) {
+    // Pin the thread before it touches any memory, so that the memory
+    // it allocates is on its node.
+    if (cpu != -1) {
+        Numa::pinThread(cpu);
+    }
+    size_t lastGen = 0;
+    while (true) {
+        // Wait for the next task (or for the pool to be destroyed).
+        const Task* current = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskReady.wait(lock, [&] { return stop || generation != lastGen; });
+            if (stop) {
+                return;
+            }
+            lastGen = generation;
+            current = task;
+        }
+        runTask(*current, id);
+        // Let run know that this thread is done.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            taskDone.notify_one();
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/** \file ThreadPool.h A simple fork-join thread pool.
+
+    This file contains a small thread pool that is used to parallelize
+    training and assessment.  The threads are created once and reused
+    for every parallel section, so the cost of a parallel section is
+    just a couple of condition-variable notifications.
+
+    Copyright (C) 2025 acharyp@miamiOH.edu
+*/
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fork-join thread pool.  The run method runs a given task on all
+ * of the threads in the pool (including the calling thread) and
+ * returns once every thread has finished.  For example:
+ *
+ * \code
+ * ThreadPool pool(4);
+ * pool.run([&](const size_t tid) { process(tid, pool.size()); });
+ * \endcode
+ */
+class ThreadPool {
+public:
+    /**
+     * A non-owning reference to a task run by the threads.  Unlike
+     * std::function this never allocates memory, which keeps parallel
+     * sections in the training loop free of heap allocations.
+     */
+    struct Task {
+        /** Pointer to the callable object (for example, a lambda) */
+        const void* callable;
+
+        /** Helper to invoke the callable with a given thread ID */
+        void (*invoke)(const void* callable, const size_t threadID);
+
+        /** Convenience operator to run the task */
+        void operator()(const size_t threadID) const {
+            invoke(callable, threadID);
+        }
+    };
+
+    /**
+     * Creates a thread pool with a given number of threads.  The
+     * calling thread counts as one of the threads, so a pool with 1
+     * thread does not create any additional threads.
+     *
+     * \param[in] threads The total number of threads to be used.
+     * Values less than 1 are treated as 1.
+     *
+     * \param[in] cpus The optional CPUs (see Numa::cpuOrder) to which
+     * the additional threads are pinned, with thread i (from 1)
+     * pinned to cpus[(i - 1) % cpus.size()].  The calling thread is
+     * not pinned, as the threads it creates later would inherit its
+     * pinning.
+     */
+    explicit ThreadPool(const size_t threads = 1,
+                        const std::vector<int>& cpus = {});
+
+    /**
+     * The destructor waits for the threads in the pool to finish.
+     */
+    ~ThreadPool();
+
+    /** The pool is not copyable as it owns threads */
+    ThreadPool(const ThreadPool&) = delete;
+
+    /** The pool is not assignable as it owns threads */
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Returns the total number of threads in this pool.
+     *
+     * \return The number of threads, including the calling thread.
+     */
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * Runs a given task on each thread in this pool. The calling
+     * thread runs the task with thread ID 0 and the other threads run
+     * it with IDs 1 to size() - 1.  This method returns only after
+     * all threads have finished running the task.  If the task throws
+     * an exception on any thread, the first such exception is
+     * rethrown by this method.
+     *
+     * \param[in] fn The callable (taking the thread ID as its only
+     * parameter) to be run by each thread.
+     */
+    template<typename Fn>
+    void run(const Fn& fn) {
+        run(Task{&fn, [](const void* callable, const size_t threadID) {
+                          (*static_cast<const Fn*>(callable))(threadID);
+                      }});
+    }
+
+    /**
+     * Runs a given task on each thread in this pool. This is the
+     * non-template version of the above method.
+     *
+     * \param[in] task The task to be run by each thread.
+     */
+    void run(const Task& task);
+
+private:
+    /**
+     * The method run by each thread in the pool that waits for tasks
+     * to be run until the pool is destroyed.
+     *
+     * \param[in] id The ID of this thread (1 to size() - 1).
+     *
+     * \param[in] cpu The CPU to pin this thread to, or -1 to not pin
+     * this thread.
+     */
+    void workerLoop(const size_t id, const int cpu);
+
+    /**
+     * Helper method to run a task on a thread and record the first
+     * exception (if any) thrown by the task.
+     *
+     * \param[in] task The task to be run.
+     *
+     * \param[in] id The ID of the thread running the task.
+     */
+    void runTask(const Task& task, const size_t id);
+
+    /** The additional threads in this pool */
+    std::vector<std::thread> workers;
+
+    /** Mutex to coordinate access to the variables below */
+    std::mutex mutex;
+
+    /** Used to notify workers that a new task is available */
+    std::condition_variable taskReady;
+
+    /** Used to notify run that all workers have finished the task */
+    std::condition_variable taskDone;
+
+    /** The current task to be run by the workers */
+    const Task* task = nullptr;
+
+    /** Incremented for each task so workers can detect a new task */
+    size_t generation = 0;
+
+    /** Number of workers that are yet to finish the current task */
+    size_t pending = 0;
+
+    /** The first exception thrown by the current task */
+    std::exception_ptr error;
+
+    /** Flag to indicate that the workers should stop */
+    bool stop = false;
+};
+
+#endif
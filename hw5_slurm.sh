@@ -15,7 +15,36 @@
 
 # g++ -g -Wall -std=c++17 -O3 -march=native -ftree-vectorize Matrix.cpp NeuralNet.cpp main.cpp -o homework5
 
-g++ -g -Wall -std=c++17 -O3 -march=native -ftree-vectorize -flto Matrix.cpp NeuralNet.cpp main.cpp -o homework5
+# g++ -g -Wall -std=c++17 -O3 -march=native -ftree-vectorize -flto Matrix.cpp NeuralNet.cpp main.cpp -o homework5
+
+# Add -DNNET_USE_FLOAT to the line below to train with 32-bit floats
+# instead of doubles.  Add -DNNET_PROFILE to print the time spent in
+# each phase (forward, backward, update, fetch, assess) of every epoch
+# as a JSON line, instead of profiling with perf record.
+#
+# The SIMD kernels in MatrixKernels.cpp are selected at runtime based
+# on the CPU, so do not use -march=native.  That way the same binary
+# runs at full speed on every node type in the cluster.
+g++ -g -Wall -std=c++17 -O3 -flto -pthread Matrix.cpp MatrixKernels.cpp NeuralNet.cpp ThreadPool.cpp DataRepository.cpp BatchLoader.cpp QuantizedNet.cpp PoolAllocator.cpp Benchmark.cpp Communicator.cpp Profiler.cpp InferenceServer.cpp GpuNet.cpp Numa.cpp main.cpp -o homework5
+
+# For distributed training across nodes, build with MPI instead and
+# raise --nodes above.  Each rank trains on its share of the images
+# and the gradients are summed across the ranks after every batch.
+# mpicxx -g -Wall -std=c++17 -O3 -flto -pthread -DNNET_USE_MPI Matrix.cpp MatrixKernels.cpp NeuralNet.cpp ThreadPool.cpp DataRepository.cpp BatchLoader.cpp QuantizedNet.cpp PoolAllocator.cpp Benchmark.cpp Communicator.cpp Profiler.cpp InferenceServer.cpp GpuNet.cpp Numa.cpp main.cpp -o homework5
+# srun ./homework5 "${TMPDIR}/data" 5000 10 train.idx test.idx 10
+
+# To train on a GPU node instead, compile the CUDA kernels with nvcc
+# and build with -DNNET_USE_CUDA.  Then pass gpu as the Mode (with a
+# packed training set) to keep the network and the dataset in device
+# memory for all the epochs.
+# nvcc -O3 -std=c++17 -c GpuKernels.cu -o GpuKernels.o
+# g++ -g -Wall -std=c++17 -O3 -pthread -DNNET_USE_CUDA -I"${CUDA_HOME}/include" Matrix.cpp MatrixKernels.cpp NeuralNet.cpp ThreadPool.cpp DataRepository.cpp BatchLoader.cpp QuantizedNet.cpp PoolAllocator.cpp Benchmark.cpp Communicator.cpp Profiler.cpp InferenceServer.cpp GpuNet.cpp Numa.cpp main.cpp GpuKernels.o -L"${CUDA_HOME}/lib64" -lcublas -lcudart -o homework5
+# ./homework5 "${TMPDIR}/data" 50000 10 train.idx test.idx 32 1 1 1 "" sigmoid,sigmoid gpu
+
+# On multi-socket nodes, pin the training threads across the sockets
+# (NUMA nodes) so that each one reads the test images and the network
+# from its own socket's memory during assessment.
+# ./homework5 "${TMPDIR}/data" 50000 10 train.idx test.idx 32 16 1 1 "" sigmoid,sigmoid sync scatter
 
 
 # Setup the mnist image files for testing and training on local
@@ -23,6 +52,13 @@ g++ -g -Wall -std=c++17 -O3 -march=native -ftree-vectorize -flto Matrix.cpp Neur
 # storage it takes a looooong time for I/O.
 unzip -q /fs/ess/PMIU0184/cse443/data/mnist_images.zip -d "${TMPDIR}"
 
+# Alternatively, pack the images once (into a shared location) and
+# then pass the packed files instead of the list files.  That avoids
+# the unzip step and parsing PGM files in every job.
+# ./homework5 --pack "${TMPDIR}/data" TrainingSetList.txt train.idx
+# ./homework5 --pack "${TMPDIR}/data" TestingSetList.txt test.idx
+# /usr/bin/time -v ./homework5 "${TMPDIR}/data" 5000 10 train.idx test.idx
+
 # Uncomment the following for profiling 
 # perf record -F 20 --call-graph dwarf ./homework5 "${TMPDIR}/data"
 
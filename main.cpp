@@ -12,262 +12,420 @@
 #include <vector>
 #include <random>
 #include <iostream>
+#include <sstream>
 #include <chrono>
-#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <memory>
+#include <type_traits>
+#include <stdexcept>
+#include <unistd.h>
 #include "Matrix.h"
 #include "NeuralNet.h"
-
-Matrix loadPGM(const std::string& path);
-Matrix getExpectedDigitOutput(const std::string& path);
+#include "ThreadPool.h"
+#include "DataRepository.h"
+#include "BatchLoader.h"
+#include "QuantizedNet.h"
+#include "Benchmark.h"
+#include "Communicator.h"
+#include "FixedNeuralNet.h"
+#include "SparseVector.h"
+#include "GpuNet.h"
+#include "InferenceServer.h"
+#include "Numa.h"
+#include "Profiler.h"
 
 /**
- * Helper method to load a PGM data file into a 1-D matrix that can be
- * supplied as training data to a NeuralNet.
+ * Helper method to parse a comma-separated list of activation
+ * functions, one for each layer after the inputs.  For example,
+ * "relu,softmax".
+ *
+ * \param[in] spec The comma-separated list of activation functions.
  *
- * \param[in] path The path from where the PGM file is to be loaded.
+ * \param[in] count The number of layers after the inputs.
  *
- * \return A nx1 matrix with each row of the matrix corresponding to a
- * pixel in the image.
+ * \return The activation function for each layer.  The list is empty
+ * if spec has an unknown name, does not have exactly count names, or
+ * uses softmax on a layer other than the output layer.
  */
-Matrix loadPGM(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.good()) {
-        throw std::runtime_error("Unable to read " + path);
-    }
-    // First read the header and dimensions
-    std::string hdr;
-    int width, height;
-    Val maxVal, value;
-    file >> hdr >> width >> height >> maxVal;
-    if (hdr != "P2") {
-        throw std::runtime_error("Only P2 PGM format is supported");
+std::vector<Activation> parseActivations(const std::string& spec,
+                                         const size_t count) {
+    std::vector<Activation> activations;
+    std::istringstream is(spec);
+    try {
+        for (std::string name; std::getline(is, name, ',');) {
+            activations.push_back(parseActivation(name));
+        }
+    } catch (const std::invalid_argument&) {
+        return {};
     }
-    // Create a column matrix to read all of the data and normalize it
-    Matrix img(width * height, 1);
-    for (int i = 0; (i < width * height); i++) {
-        file >> value;
-        img.data[i * 1] = value / maxVal;
+    if (activations.size() != count ||
+        std::find(activations.begin(), activations.end() - 1,
+                  Activation::Softmax) != activations.end() - 1) {
+        return {};
     }
-    return img;
+    return activations;
 }
 
 /**
- * Helper method to compute the expected output for a given image.
- * The expected output is determined from the last digit in a given
- * file name.  For example, if the path is test-image-6883_0.pgm, this
- * method extracts the last "0" in the file name and uses that as the
- * expected digit.  It This method returns a 10x1 matrix with the
- * entry corresponding to the given digit to be set to 1.
- *
- * \paran[in] path The path to the PGM file from where the actual digit is to be extracted.
+ * Helper method to print the command-line usage of this program.
  */
-Matrix getExpectedDigitOutput(const std::string& path) {
-    // Path is of the form .../data/TrainingSet/test-image-6883_0.pgm
-    // We need to get to the last "_n" part and use 'n' as the label.
-    const auto labelPos = path.rfind('_') + 1;
-    // Now we know the index position of the 1-digit label.  Convert
-    // the character to integer for convenience.
-    const int label = path[labelPos] - '0';
-    // Now create the expected matrix with the just the value
-    // corresponding to the label set to 1.0
-    Matrix expected(10, 1, 0.0);
-    expected.data[label * 1] = 1.0;  // Just label should be 1.0
-    return expected;
+void printUsage() {
+    std::cout << "Usage: <ImgPath> [#Train] [#Epocs] [TrainSetList] "
+              << "[TestSetList] [BatchSize] [Threads] [Loaders]"
+              << " [Seed] [ModelFile] [Activations] [Mode] [Pinning]"
+              << " [Inputs]\n"
+              << "   or: --pack <ImgPath> <ImgList> <OutFile>\n"
+              << "   or: --assess <ModelFile> <ImgPath> <TestSetList> "
+              << "[Threads]\n"
+              << "   or: --serve <ModelFile> [ImgPath] [MaxBatch] "
+              << "[MaxWaitUs] [Port]\n"
+              << "   or: --bench [ImgPath] [ImgList] [Filter]\n";
 }
 
 /**
- * DataRepository: A caching layer that stores loaded images and labels
- * to avoid redundant file I/O operations across multiple epochs.
+ * Helper method that trains a given neural network using a sequence
+ * of images.  The images are assembled into mini-batches (with one
+ * image per column) via a given callable.  This method is shared by
+ * the different sources of images (PGM files and packed datasets).
+ *
+ * \param[in,out] net The neural network to be trainined.  This is
+ * either a NeuralNet or a FixedNeuralNet, which only supports a
+ * batch size of 1.
+ *
+ * \param[in] count The number of images to be used.
+ *
+ * \param[in] imgSize The number of pixels in each image.
+ *
+ * \param[in] batchSize The number of images to be used in each
+ * mini-batch.  A batch size of 1 trains the network one image at a
+ * time via NeuralNet::learn.
+ *
+ * \param[in] pool An optional set of threads to split each mini-batch
+ * across.  This is not used with a batch size of 1.
+ *
+ * \param[in] fill The callable fill(i, imgs, exps, col) that copies
+ * the i-th image and its expected output into column col of the
+ * imgs and exps batch matrices respectively.
+ *
+ * \param[in] loaders The number of background threads that assemble
+ * upcoming mini-batches (via BatchLoader) while the current one is
+ * used for training.  If this value is zero, then each mini-batch is
+ * assembled by the calling thread just before it is used.
+ *
+ * \param[in,out] comm The optional ranks training the network
+ * together.  With more than one rank, the images are this rank's
+ * share of the mini-batches and the gradients are summed across
+ * the ranks (instead of being split across the threads in pool).
+ *
+ * \param[in] hogwild If true, the images in each mini-batch are
+ * learnt one at a time by the threads in pool, which update the
+ * network asynchronously (see NeuralNet::learnHogwild).
  */
-class DataRepository {
-public:
-    /**
-     * Fetches an image from the cache or loads it from disk if not cached.
-     * 
-     * \param[in] fullpath The full path to the PGM image file.
-     * 
-     * \return A const reference to the cached Matrix containing the image data.
-     */
-    static const Matrix& fetchImage(const std::string& fullpath) {
-        auto& store = getImageStore();
-        if (auto it = store.find(fullpath); it != store.end())
-            return it->second;
-
-        Matrix img = loadPGM(fullpath);
-        auto [pos, _] = store.emplace(fullpath, std::move(img));
-        return pos->second;
-    }
-
-    /**
-     * Fetches a label matrix from the cache or generates it if not cached.
-     * 
-     * \param[in] filename The image filename used to extract the expected digit label.
-     * 
-     * \return A const reference to the cached Matrix containing the label data.
-     */
-    static const Matrix& fetchLabel(const std::string& filename) {
-        auto& store = getLabelStore();
-        if (auto it = store.find(filename); it != store.end())
-            return it->second;
-
-        Matrix lbl = getExpectedDigitOutput(filename);
-        auto [pos, _] = store.emplace(filename, std::move(lbl));
-        return pos->second;
-    }
-
-    /**
-     * Clears all cached images and labels from memory.
-     * This can be used to free memory between experiments or test runs.
-     */
-    static void reset() {
-        getImageStore().clear();
-        getLabelStore().clear();
+template<typename Net, typename FillFn>
+void trainBatches(Net& net, const size_t count, const size_t imgSize,
+                  const int batchSize, ThreadPool* pool, const FillFn& fill,
+                  const int loaders, Communicator* comm = nullptr,
+                  const bool hogwild = false) {
+    const auto learn = [&](const Matrix& imgs, const Matrix& exps) {
+        NNET_PROFILE_COUNT(Profiler::Counter::Samples, imgs.cols);
+        if constexpr (!std::is_same<Net, NeuralNet>::value) {
+            net.learn(imgs, exps);
+        } else if (comm != nullptr && comm->size() > 1) {
+            net.learnBatch(imgs, exps, 0.3, *comm);
+        } else if (hogwild && pool != nullptr) {
+            net.learnHogwild(imgs, exps, 0.3, *pool);
+        } else if (batchSize <= 1) {
+            net.learn(imgs, exps);
+        } else if (pool != nullptr) {
+            net.learnBatch(imgs, exps, 0.3, *pool);
+        } else {
+            net.learnBatch(imgs, exps);
+        }
+    };
+    const size_t perBatch = std::max(batchSize, 1);
+    if (loaders > 0) {
+        BatchLoader loader(count, imgSize, perBatch, fill, loaders);
+        while (const auto* batch = loader.next()) {
+            learn(batch->inputs, batch->expected);
+        }
+        return;
     }
-
-private:
-    /**
-     * Returns a reference to the static image cache.
-     * 
-     * \return A reference to the unordered_map storing cached images.
-     */
-    static std::unordered_map<std::string, Matrix>& getImageStore() {
-        static std::unordered_map<std::string, Matrix> imageStore;
-        return imageStore;
+    Matrix imgs, exps;
+    for (size_t start = 0; (start < count); start += perBatch) {
+        const size_t size = std::min(perBatch, count - start);
+        // Resize reuses the storage from the previous batch
+        imgs.resize(imgSize, size);
+        exps.resize(10, size);
+        for (size_t i = 0; (i < size); i++) {
+            fill(start + i, imgs, exps, i);
+        }
+        learn(imgs, exps);
     }
+}
 
-    /**
-     * Returns a reference to the static label cache.
-     * 
-     * \return A reference to the unordered_map storing cached labels.
-     */
-    static std::unordered_map<std::string, Matrix>& getLabelStore() {
-        static std::unordered_map<std::string, Matrix> labelStore;
-        return labelStore;
+/**
+ * Helper method to randomly shuffle the indexes of the images used in
+ * an epoch.
+ *
+ * \param[in] size The number of images in the dataset.
+ *
+ * \param[in] limit The number of images to be used.  The indexes of
+ * the first \c limit images are shuffled.
+ *
+ * \param[in,out] rng The random number generator used to shuffle the
+ * images.
+ *
+ * \param[in] comm The optional ranks training the network together.
+ * With more than one rank, only this rank's contiguous share of the
+ * shuffled indexes is returned.
+ *
+ * \return The shuffled indexes of the images.
+ */
+std::vector<size_t> shuffledOrder(const size_t size, const int limit,
+                                  std::default_random_engine& rng,
+                                  const Communicator* comm = nullptr) {
+    std::vector<size_t> order(std::min<size_t>(limit, size));
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    if (comm != nullptr && comm->size() > 1) {
+        // Keep this rank's share.  Every rank gets the same number of
+        // images so that all ranks take part in every mini-batch.
+        const size_t share = order.size() / comm->size();
+        order.erase(order.begin(), order.begin() + share * comm->rank());
+        order.resize(share);
     }
-};
+    return order;
+}
 
 /**
- * Helper method to use the first \c count number of files to train a
- * given neural network.
+ * The top-level method to train a given neural network for one epoch
+ * using images from a given dataset (either a DatasetIndex built
+ * from a list of PGM files or a PackedDataset).
+ *
+ * \param[in,out] net The neural network (a NeuralNet or FixedNeuralNet)
+ * to be trained.
+ *
+ * \param[in] dataset The dataset with the training images.
+ *
+ * \param[in] limit The number of images to be used to train the
+ * network. This method randomly shuffles the indexes of the first
+ * \c limit images in the dataset before using them for training.
+ *
+ * \param[in,out] rng The random number generator used to shuffle the
+ * images.  The same generator is used in every epoch, so that each
+ * epoch uses a different (but reproducible) order of images.
+ *
+ * \param[in] batchSize The number of images in each mini-batch.  A
+ * batch size of 1 trains the network one image at a time via
+ * NeuralNet::learn.
  *
- * \param[in,out] net The neural network to be trainined.
+ * \param[in] pool An optional set of threads to split each mini-batch
+ * across.  This is not used with a batch size of 1.
  *
- * \param[in] path The prefix path to the location where the training
- * images are actually stored.
- * 
- * \param[in] fileNames The list of PGM image file names to be used
- * for training.
+ * \param[in] loaders The number of background threads used to load
+ * upcoming mini-batches.  Zero loads images in the calling thread.
  *
- * \param[in] count The number of files in this list ot be used.
+ * \param[in,out] comm The optional ranks training the network
+ * together.  All the ranks shuffle the images in the same order (as
+ * they use the same seed) and each rank then trains on its own
+ * contiguous share of the shuffled images.  Each mini-batch thus has
+ * batchSize images on each rank.
+ *
+ * \param[in] hogwild If true, train asynchronously with the threads
+ * in pool (see trainBatches).
  */
-void train(NeuralNet& net, const std::string& path,
-           const std::vector<std::string>& fileNames,
-           int count = 1e6) {
-    // Use DataRepository to cache images and labels across epochs
-    for (const auto& imgName : fileNames) {
-        const std::string fullPath = path + "/" + imgName;
-        const Matrix& img = DataRepository::fetchImage(fullPath);
-        const Matrix& exp = DataRepository::fetchLabel(imgName);
-        net.learn(img, exp);
-    }
+template<typename Net, typename Dataset>
+void train(Net& net, const Dataset& dataset, const int limit,
+           std::default_random_engine& rng, const int batchSize = 1,
+           ThreadPool* pool = nullptr, const int loaders = 1,
+           Communicator* comm = nullptr, const bool hogwild = false) {
+    const std::vector<size_t> order = shuffledOrder(dataset.size(), limit,
+                                                    rng, comm);
+    const auto fill = [&](const size_t i, Matrix& imgs, Matrix& exps,
+                          const size_t col) {
+        NNET_PROFILE_SCOPE(Profiler::Phase::Fetch);
+        dataset.copyImage(order[i], imgs, col);
+        dataset.copyLabel(order[i], exps, col);
+    };
+    trainBatches(net, order.size(), dataset.imageSize(), batchSize, pool,
+                 fill, loaders, comm, hogwild);
 }
 
 /**
- * The top-level method to train a given neural network used a list of
- * files from a given training set.
+ * Trains a FixedNeuralNet for one epoch, one image at a time, using
+ * the sparse form of each image (see SparseVector).  Each image is
+ * copied from the dataset directly into the sparse form, rather than
+ * into a dense batch that the network would scan for the non-zero
+ * pixels.  Only the non-zero pixels are copied, so the images are
+ * not assembled by background loaders (see train).
  *
- * \param[in,out] net The neural network to be trained.
+ * \param[in,out] net The network to be trained.
  *
- * \param[in] path The prefix path to the location where the training
- * images are actually stored.
+ * \param[in] dataset The dataset (a DatasetIndex or a PackedDataset)
+ * with the training images.
  *
- * \param[in] limit The number of files to be used to train the network.
+ * \param[in] limit The number of images to be used, as in train.
  *
- * \param[in] imgListFile The file that contains a list of PGM files
- * to be used.  This method randomly shuffles this list before using
- * \c limit nunber of images for training the supplied \c net.
+ * \param[in,out] rng The random number generator used to shuffle the
+ * images.
  */
-void train(NeuralNet& net, const std::string& path, const int limit = 1e6,
-           const std::string& imgListFile = "TrainingSetList.txt") {
-    std::ifstream fileList(imgListFile);
-    if (!fileList) {
-        throw std::runtime_error("Error reading: " + imgListFile);
-    }
-    std::vector<std::string> fileNames;
-    int count = 0;
-    // Load the data from the given image file list.
-    for (std::string imgName; std::getline(fileList, imgName) &&
-             count < limit; count++) {
-        fileNames.push_back(imgName);
+template<typename Net, typename Dataset>
+void trainSparse(Net& net, const Dataset& dataset, const int limit,
+                 std::default_random_engine& rng) {
+    const std::vector<size_t> order = shuffledOrder(dataset.size(), limit,
+                                                    rng);
+    SparseVector inputs;
+    Matrix expected(10, 1);
+    for (const size_t idx : order) {
+        {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Fetch);
+            dataset.copySparseImage(idx, inputs);
+            dataset.copyLabel(idx, expected, 0);
+        }
+        NNET_PROFILE_COUNT(Profiler::Counter::Samples, 1);
+        net.learn(inputs, expected.data.data());
     }
-    // Randomly shuffle the list of file names so that we use a random
-    // subset of PGM files for training.
-    std::default_random_engine rg;
-    std::shuffle(fileNames.begin(), fileNames.end(),
-                 std::default_random_engine());
-    // Use the helper method to train 
-    train(net, path, fileNames, limit);
 }
 
 /**
- * Helper method to get the index of the maximum element in a given
- * list. For example maxElemIndex({1, 3, -1, 2}) returns 1.
+ * The copies of the networks being assessed on each NUMA node used by
+ * the threads (see Numa::Replicated).  They are created in the first
+ * epoch and then updated in every epoch, reusing their memory.
+ */
+struct NetReplicas {
+    /** The copies of the network */
+    Numa::Replicated<NeuralNet> net;
+
+    /** The copies of the int8 version of the network */
+    Numa::Replicated<QuantizedNet> qnet;
+};
+
+/**
+ * Helper method to count the number of images that are correctly
+ * classified by a given neural network.  The images are assembled
+ * into batches (one image per column) via a given callable. This
+ * method is shared by the different sources of images.
+ *
+ * \param[in] net The network to be used for classification.  This
+ * can be a NeuralNet or a QuantizedNet.
+ *
+ * \param[in] expIdx The expected digit for each image.
+ *
+ * \param[in] imgSize The number of pixels in each image.
  *
- * \param[in] vec The vector whose maximum element index is to be
- * returned by this method. This list cannot be empty.
+ * \param[in] pool An optional set of threads across which the list
+ * of images is sharded.  Each thread classifies its share of the
+ * images in batches.
  *
- * \return The index position of the maximum element.
+ * \param[in] fill The callable fill(i, batch, col) that copies the
+ * i-th image into column col of the batch.  This callable is called
+ * concurrently from multiple threads.
+ *
+ * \param[in] replicas The optional copies of net (already set to net)
+ * on each NUMA node.  Each thread then uses the copy on its own node.
+ *
+ * \return The number of images correctly classified by the network.
  */
-int maxElemIndex(const std::vector<Val>& vec) {
-    return std::max_element(vec.begin(), vec.end()) - vec.begin();
+template<typename Net, typename FillFn>
+int assessBatches(const Net& net, const std::vector<int>& expIdx,
+                  const size_t imgSize, ThreadPool* pool,
+                  const FillFn& fill,
+                  const Numa::Replicated<Net>* replicas = nullptr) {
+    // Each thread handles a contiguous share of the images, in
+    // batches to use matrix-matrix products.
+    const int totCount = expIdx.size(), BatchSize = 100;
+    const int threads = (pool != nullptr) ? pool->size() : 1;
+    std::vector<int> passCounts(threads, 0);
+    const auto classifyShare = [&](const size_t tid) {
+        const int start = totCount * tid / threads;
+        const int end   = totCount * (tid + 1) / threads;
+        const Net* replica = (replicas != nullptr) ? replicas->local() :
+            nullptr;
+        const Net& localNet = (replica != nullptr) ? *replica : net;
+        Matrix batch;
+        for (int first = start; (first < end); first += BatchSize) {
+            const int size = std::min(BatchSize, end - first);
+            batch.resize(imgSize, size);
+            for (int i = 0; (i < size); i++) {
+                fill(first + i, batch, i);
+            }
+            const std::vector<int> resIdx = localNet.classifyBatch(batch);
+            for (int i = 0; (i < size); i++) {
+                passCounts[tid] += (resIdx[i] == expIdx[first + i]);
+            }
+        }
+    };
+    if (pool != nullptr) {
+        pool->run(classifyShare);
+    } else {
+        classifyShare(0);
+    }
+    return std::accumulate(passCounts.begin(), passCounts.end(), 0);
 }
 
-
 /**
  * Helper method to determine how well a given neural network has
- * trained used a list of test images.
+ * trained using the images in a given dataset (either a DatasetIndex
+ * or a PackedDataset).
  *
  * \param[in] net The network to be used for classification.
  *
- * \param[in] path The prefix path to the location where the training
- * images are actually stored.
- * 
- * \param[in] imgFileList A text file containing the list of
- * image-file-names to be used for assessing the effectiveness of the
- * supplied \c net.
+ * \param[in] dataset The dataset with the test images.
+ *
+ * \param[in] pool An optional set of threads across which the images
+ * are sharded.  Each thread classifies its share of the images in
+ * batches.
+ *
+ * \param[in,out] replicas The optional copies of the networks on each
+ * NUMA node used by the threads in pool, which are set to net (and to
+ * its int8 version) by this method.  These copies are only useful if
+ * the threads are pinned (see Numa::Replicated), so pass nullptr for
+ * unpinned threads.
+ *
+ * This method also reports the accuracy of the int8 quantized version
+ * of the network (see QuantizedNet), if it can be quantized, and the
+ * change in accuracy due to the quantization.
  */
-void assess(NeuralNet& net, const std::string& path,
-            const std::string& imgFileList = "TestingSetList.txt") {
-    std::ifstream fileList2(imgFileList);
-    if (!fileList2) {
-        throw std::runtime_error("Error reading " + imgFileList);
+template<typename Dataset>
+void assess(const NeuralNet& net, const Dataset& dataset,
+            ThreadPool* pool = nullptr, NetReplicas* replicas = nullptr) {
+    std::vector<int> expIdx(dataset.size());
+    for (size_t i = 0; (i < dataset.size()); i++) {
+        expIdx[i] = dataset.label(i);
     }
-    // Check how many of the images are correctly classified by the
-    // given given neural network.
-
-    int passCount = 0, totCount = 0;
-    for (std::string imgName; std::getline(fileList2, imgName); totCount++) {
-        const std::string fullPath = path + "/" + imgName;
-        const Matrix& img = DataRepository::fetchImage(fullPath);
-        const Matrix& exp = DataRepository::fetchLabel(imgName);
-        // Have our network classify the image.
-        const Matrix res = net.classify(img);
-        assert(res.width() == 1);
-        assert(res.height() == 10);
-        // Find the maximum index positions in exp results to see if
-        // they are the same. If they are it is a good
-        // result. Otherwise, it is an error.
-        const int expIdx = maxElemIndex(exp.transpose().data);
-        const int resIdx = maxElemIndex(res.transpose().data);
-
-        if (expIdx == resIdx) {
-            passCount++;
-        }
-        // std::cout << imgName.substr(imgName.rfind('/'))
-        //           << '\t' << expIdx << '\t' << resIdx << '\n';
+    const auto fill = [&](const size_t i, Matrix& batch, const size_t col) {
+        dataset.copyImage(i, batch, col);
+    };
+    const int totCount = dataset.size();
+    if (totCount == 0) {
+        return;
+    }
+    // The networks are only read here, so each node can have its own.
+    const bool replicate = (pool != nullptr && replicas != nullptr);
+    if (replicate) {
+        replicas->net.assign(*pool, net);
     }
+    const int passCount = assessBatches(net, expIdx, dataset.imageSize(),
+                                        pool, fill,
+                                        replicate ? &replicas->net : nullptr);
     std::cout << "Correct classification: " << passCount << " ["
-              << (passCount * 1.f / totCount) << "% ]\n";
+              << (passCount * 100.f / totCount) << "% ]\n";
+    // Report the accuracy of the int8 version of the network as well.
+    if (!QuantizedNet::isSupported(net)) {
+        return;
+    }
+    const QuantizedNet qnet(net);
+    if (replicate) {
+        replicas->qnet.assign(*pool, qnet);
+    }
+    const int qPassCount = assessBatches(qnet, expIdx, dataset.imageSize(),
+                                         pool, fill,
+                                         replicate ? &replicas->qnet : nullptr);
+    std::cout << "Int8 classification: " << qPassCount << " ["
+              << (qPassCount * 100.f / totCount) << "% ], delta = "
+              << ((qPassCount - passCount) * 100.f / totCount) << "%\n";
 }
 
 /**
@@ -276,7 +434,7 @@ void assess(NeuralNet& net, const std::string& path,
  *
  * \param[in] argc The numebr of command-line arguments.  This program
  * requires one path where training & test images are stored. It
- * optionally accepts up to 4 optional command-line arguments.
+ * optionally accepts up to 13 optional command-line arguments.
  *
  * \param[in] argv The actual command-line argument.
  *     1. The path where training and test images are stored.
@@ -289,35 +447,311 @@ void assess(NeuralNet& net, const std::string& path,
  *     5. The file containing the list of testing images to be
  *        used. By default this parameter is set to
  *        "TestingSetList.txt".
+ *     6. The number of images in each mini-batch used for training.
+ *        Default is 1 (i.e., learn one image at a time).
+ *     7. The number of threads across which each mini-batch is split
+ *        for data-parallel training (and the test images are sharded
+ *        for assessment). Default is 1.
+ *     8. The number of background threads that load upcoming
+ *        mini-batches while the current one is used. Zero loads
+ *        images in the main thread. Default is 1.
+ *     9. The seed for the random number generator used to shuffle
+ *        the training images in every epoch.
+ *    10. An optional checkpoint file to which the network is saved
+ *        (see NeuralNet::saveCheckpoint) at the end of each epoch.
+ *    11. A comma-separated list of the activation functions for the
+ *        hidden and output layers (sigmoid, relu, tanh, or softmax).
+ *        Default is "sigmoid,sigmoid". A softmax output layer is
+ *        trained with cross-entropy and other outputs with the
+ *        quadratic cost.
+ *    12. The training mode, which is either "sync" (the default) or
+ *        "hogwild".  In the hogwild mode the threads learn from the
+ *        images one at a time and update the network without any
+ *        locks (see NeuralNet::learnHogwild).  The BatchSize is then
+ *        just the number of images handed to the threads at once,
+ *        and a few hundred keeps all the threads busy.  The "gpu"
+ *        mode trains on a GPU (see GpuNet), which requires building
+ *        with -DNNET_USE_CUDA and a packed TrainSetList.  The
+ *        "fixed" mode trains the faster FixedNeuralNet version of
+ *        the network one image at a time, which requires sigmoid
+ *        layers, a BatchSize of 1, and a single rank.
+ *    13. How the Threads are pinned to cores (see Numa::Pinning),
+ *        which is "none" (the default), "compact" (filling one NUMA
+ *        node before the next), or "scatter" (spreading them across
+ *        the nodes).  On multi-socket machines, pinned threads also
+ *        assess with a copy of the network (and of a packed
+ *        TestSetList) on their own node.
+ *    14. The form of the inputs to the first layer, which is either
+ *        "dense" (the default) or "sparse".  With sparse inputs, the
+ *        first layer skips the zero pixels of the images (see
+ *        NeuralNet::setSparseInputs) in every mode except gpu, which
+ *        pays off with a BatchSize of 1 or in the hogwild mode.  In
+ *        the fixed mode, the sparse form of each image is copied
+ *        straight from the dataset (see trainSparse) instead of
+ *        being assembled into a dense batch first.
+ *
+ * The TrainSetList and TestSetList can also be packed datasets (see
+ * PackedDataset) in which case the images are read from the packed
+ * file instead of the individual PGM files under ImgPath.  A packed
+ * dataset is created by running this program as:
+ *     --pack <ImgPath> <ImgList> <OutFile>
+ *
+ * A saved checkpoint can be assessed (without any training) by
+ * running this program as:
+ *     --assess <ModelFile> <ImgPath> <TestSetList> [Threads]
+ *
+ * A saved checkpoint can be served (see InferenceServer) by running
+ * this program as shown below.  The requests (one per line) are read
+ * from stdin or, if a Port is given, from TCP connections on that
+ * port.  Requests that arrive within MaxWaitUs microseconds (default
+ * 1000) of each other are classified together in batches of up to
+ * MaxBatch (default 64) images:
+ *     --serve <ModelFile> [ImgPath] [MaxBatch] [MaxWaitUs] [Port]
+ *
+ * The benchmark suite (see runBenchmarks) is run by running this
+ * program as shown below.  The image loading benchmarks are run only
+ * if an ImgList is given, and a Filter restricts the benchmarks to
+ * those whose names contain it:
+ *     --bench [ImgPath] [ImgList] [Filter]
+ *
+ * When built with -DNNET_USE_MPI and started via mpirun (or srun),
+ * the training images are split across the ranks (see train) and
+ * the gradients of every mini-batch are summed across all of them.
+ * Rank 0 assesses the network, prints the results, and saves the
+ * checkpoints.
+ *
+ * When built with -DNNET_PROFILE, the time spent in each phase (see
+ * Profiler) and the cache and allocation counts of every epoch are
+ * also printed as a JSON line after its elapsed time.
  */
 int main(int argc, char *argv[]) {
+    // Set up MPI (if enabled) before the arguments are used.
+    Communicator comm(argc, argv);
     // We definitely need 1 argument for the base-path where image
     // files are stored.
     if (argc < 2) {
-        std::cout << "Usage: <ImgPath> [#Train] [#Epocs] [TrainSetList] "
-                  << "[TestSetList]\n";
+        printUsage();
         return 1;
     }
+    // Convert a list of PGM files to a packed dataset if requested.
+    if (std::string(argv[1]) == "--pack") {
+        if (argc != 5) {
+            std::cout << "Usage: --pack <ImgPath> <ImgList> <OutFile>\n";
+            return 1;
+        }
+        const size_t count = PackedDataset::write(argv[2], argv[3], argv[4]);
+        std::cout << "Packed " << count << " images into " << argv[4] << '\n';
+        return 0;
+    }
+    // Run the benchmark suite if requested.
+    if (std::string(argv[1]) == "--bench") {
+        runBenchmarks(std::cout, (argc > 2 ? argv[2] : ""),
+                      (argc > 3 ? argv[3] : ""), (argc > 4 ? argv[4] : ""));
+        return 0;
+    }
+    // Assess a network loaded from a checkpoint if requested.
+    if (std::string(argv[1]) == "--assess") {
+        if (argc < 5) {
+            std::cout << "Usage: --assess <ModelFile> <ImgPath> "
+                      << "<TestSetList> [Threads]\n";
+            return 1;
+        }
+        const NeuralNet net = NeuralNet::loadCheckpoint(argv[2]);
+        ThreadPool pool(argc > 5 ? std::stoi(argv[5]) : 1);
+        if (PackedDataset::isPacked(argv[4])) {
+            assess(net, DataRepository::fetchDataset(argv[4]), &pool);
+        } else {
+            assess(net, DatasetIndex(argv[3], argv[4]), &pool);
+        }
+        return 0;
+    }
+    // Serve classification requests using a checkpoint if requested.
+    if (std::string(argv[1]) == "--serve") {
+        if (argc < 3) {
+            std::cout << "Usage: --serve <ModelFile> [ImgPath] [MaxBatch] "
+                      << "[MaxWaitUs] [Port]\n";
+            return 1;
+        }
+        const NeuralNet net = NeuralNet::loadCheckpoint(argv[2]);
+        const std::string imgPath = (argc > 3 ? argv[3] : ".");
+        InferenceServer server(net, (argc > 4 ? std::stoul(argv[4]) : 64),
+                               std::chrono::microseconds(
+                                   argc > 5 ? std::stol(argv[5]) : 1000));
+        if (argc > 6) {
+            server.listen(std::stoi(argv[6]), imgPath);
+        } else {
+            server.serve(STDIN_FILENO, STDOUT_FILENO, imgPath);
+        }
+        return 0;
+    }
     // Process optional command-line arguments or use default values.
     const int imgCount  = (argc > 2 ? std::stoi(argv[2]) : 5000);
     const int epochs    = (argc > 3 ? std::stoi(argv[3]) : 10);    
     const std::string trainImgs = (argc > 4 ? argv[4] : "TrainingSetList.txt");
     const std::string testImgs  = (argc > 5 ? argv[5] : "TestingSetList.txt");
+    const int batchSize = (argc > 6 ? std::stoi(argv[6]) : 1);
+    const int threads   = (argc > 7 ? std::stoi(argv[7]) : 1);
+    const int loaders   = (argc > 8 ? std::stoi(argv[8]) : 1);
+    const unsigned seed = (argc > 9 ? std::stoul(argv[9]) :
+                           std::default_random_engine::default_seed);
+    const std::string modelFile = (argc > 10 ? argv[10] : "");
+    const std::vector<Activation> activations =
+        parseActivations(argc > 11 ? argv[11] : "sigmoid,sigmoid", 2);
+    if (activations.empty()) {
+        std::cout << "Activations needs 2 of sigmoid, relu, tanh, or "
+                  << "softmax (only on the output layer)\n";
+        printUsage();
+        return 1;
+    }
+    const std::string mode = (argc > 12 ? argv[12] : "sync");
+    if (mode != "sync" && mode != "hogwild" && mode != "gpu" &&
+        mode != "fixed") {
+        std::cout << "Unknown training mode: " << mode << '\n';
+        return 1;
+    }
+    const Numa::Pinning pinning =
+        Numa::parsePinning(argc > 13 ? argv[13] : "none");
+    const std::string inputs = (argc > 14 ? argv[14] : "dense");
+    if (inputs != "dense" && inputs != "sparse") {
+        std::cout << "Unknown form of inputs: " << inputs << '\n';
+        return 1;
+    }
+    const bool sparse = (inputs == "sparse");
+    const Loss loss = (activations.back() == Activation::Softmax) ?
+        Loss::CrossEntropy : Loss::Quadratic;
+
+    // Memory-map packed datasets just once, if they are used.
+    // Otherwise, index the lists of PGM files just once.
+    const PackedDataset* trainSet = nullptr;
+    const PackedDataset* testSet  = nullptr;
+    std::unique_ptr<DatasetIndex> trainList, testList;
+    if (PackedDataset::isPacked(trainImgs)) {
+        trainSet = &DataRepository::fetchDataset(trainImgs);
+    } else {
+        trainList = std::make_unique<DatasetIndex>(argv[1], trainImgs);
+    }
+    if (PackedDataset::isPacked(testImgs)) {
+        testSet = &DataRepository::fetchDataset(testImgs);
+    } else {
+        testList = std::make_unique<DatasetIndex>(argv[1], testImgs);
+    }
 
-    // Create the neural netowrk
-    NeuralNet net({784, 30, 10});
+    // Create the neural netowrk and the threads used for training
+    NeuralNet net({784, 30, 10}, activations, loss);
+    net.broadcast(comm);
+    net.setSparseInputs(sparse);
+    // The fixed mode trains the fixed-topology version of the network
+    // one image at a time.  It is copied back to net in every epoch
+    // for assessment and checkpoints.
+    using FixedNet = FixedNeuralNet<784, 30, 10>;
+    std::unique_ptr<FixedNet> fixedNet;
+    if (mode == "fixed") {
+        if (batchSize > 1 || comm.size() > 1 || loss != Loss::Quadratic ||
+            std::any_of(activations.begin(), activations.end(),
+                        [](const Activation act) {
+                            return act != Activation::Sigmoid; })) {
+            std::cout << "The fixed mode needs sigmoid layers, a BatchSize "
+                      << "of 1, and a single rank\n";
+            return 1;
+        }
+        fixedNet = std::make_unique<FixedNet>(net);
+    }
+    // The gpu mode keeps the network and the packed training set in
+    // device memory and copies the network back in every epoch.
+    std::unique_ptr<GpuNet> gpuNet;
+    if (mode == "gpu") {
+        if (!GpuNet::isAvailable() || trainSet == nullptr ||
+            comm.size() > 1) {
+            std::cout << "The gpu mode needs a GPU (and -DNNET_USE_CUDA), "
+                      << "a packed TrainSetList, and a single rank\n";
+            return 1;
+        }
+        gpuNet = std::make_unique<GpuNet>(net);
+    }
+    ThreadPool pool(threads, Numa::cpuOrder(pinning));
+    // Pinned threads assess with copies of the network and of a packed
+    // test set on their own NUMA node.
+    NetReplicas replicas;
+    NetReplicas* const assessReplicas =
+        (pinning != Numa::Pinning::None) ? &replicas : nullptr;
+    if (testSet != nullptr && pinning != Numa::Pinning::None) {
+        testSet->replicate(pool);
+    }
+    std::default_random_engine rng(seed);
     // Train it in at most 30 epochs.
     for (int i = 0; (i < epochs); i++) {
-        std::cout << "-- Epoch #" << i << " --\n";
-        std::cout << "Training with " << imgCount << " images...\n";
+        if (comm.isRoot()) {
+            std::cout << "-- Epoch #" << i << " --\n";
+            std::cout << "Training with " << imgCount << " images";
+            if (comm.size() > 1) {
+                std::cout << " on " << comm.size() << " ranks";
+            }
+            std::cout << "...\n";
+        }
         const auto startTime = std::chrono::high_resolution_clock::now();
-        train(net, argv[1], imgCount, trainImgs);
-        assess(net, argv[1], testImgs);
+        if (i == 0) {
+            // Load the PGM files used by all the epochs in parallel,
+            // using only as many threads as requested.
+            NNET_PROFILE_SCOPE(Profiler::Phase::Fetch);
+            if (trainList != nullptr) {
+                trainList->preload(threads, imgCount);
+            }
+            if (testList != nullptr && comm.isRoot()) {
+                testList->preload(threads);
+            }
+        }
+        if (gpuNet != nullptr) {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Train);
+            const std::vector<size_t> order =
+                shuffledOrder(trainSet->size(), imgCount, rng);
+            gpuNet->learn(*trainSet, order, batchSize);
+            net = gpuNet->toNeuralNet();
+            net.setSparseInputs(sparse);
+        } else if (fixedNet != nullptr) {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Train);
+            if (sparse && trainSet != nullptr) {
+                trainSparse(*fixedNet, *trainSet, imgCount, rng);
+            } else if (sparse) {
+                trainSparse(*fixedNet, *trainList, imgCount, rng);
+            } else if (trainSet != nullptr) {
+                train(*fixedNet, *trainSet, imgCount, rng, 1, nullptr,
+                      loaders);
+            } else {
+                train(*fixedNet, *trainList, imgCount, rng, 1, nullptr,
+                      loaders);
+            }
+            net = fixedNet->toNeuralNet();
+            net.setSparseInputs(sparse);
+        } else if (trainSet != nullptr) {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Train);
+            train(net, *trainSet, imgCount, rng, batchSize, &pool, loaders,
+                  &comm, mode == "hogwild");
+        } else {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Train);
+            train(net, *trainList, imgCount, rng, batchSize, &pool, loaders,
+                  &comm, mode == "hogwild");
+        }
+        if (!comm.isRoot()) {
+            continue;  // Only rank 0 reports and saves the network.
+        }
+        if (testSet != nullptr) {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Assess);
+            assess(net, *testSet, &pool, assessReplicas);
+        } else {
+            NNET_PROFILE_SCOPE(Profiler::Phase::Assess);
+            assess(net, *testList, &pool, assessReplicas);
+        }
+        if (!modelFile.empty()) {
+            net.saveCheckpoint(modelFile);
+        }
         const auto endTime = std::chrono::high_resolution_clock::now();
         // Compute the timeelapsed for this epoch
         using namespace std::literals;
         std::cout << "Elapsed time = " << ((endTime - startTime) / 1ms)
                   << " milliseconds.\n";
+        if constexpr (Profiler::Enabled) {
+            Profiler::writeJson(std::cout, i);
+        }
     }
     return 0;
 }